@@ -35,11 +35,12 @@ static const char *colors[][3]      = {
 typedef struct {
 	const char *name;
 	const void *cmd;
+	int prewarm; /* 1 means keep one started and hidden, for instant toggling */
 } Sp;
 const char *spcmd1[] = {"st", "-n", "spterm", "-g", "120x34", NULL };
 static Sp scratchpads[] = {
-	/* name          cmd  */
-	{"spterm",      spcmd1},
+	/* name          cmd        prewarm */
+	{"spterm",      spcmd1,     1 },
 };
 
 
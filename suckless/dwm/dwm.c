@@ -21,15 +21,22 @@
  * To understand everything else, start reading main().
  */
 #include <errno.h>
+#include <fcntl.h>
 #include <locale.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#ifdef __linux__
+#include <linux/memfd.h>
+#include <sys/syscall.h>
+#endif /* __linux__ */
 #include <X11/cursorfont.h>
 #include <X11/keysym.h>
 #include <X11/Xatom.h>
@@ -39,6 +46,13 @@
 #ifdef XINERAMA
 #include <X11/extensions/Xinerama.h>
 #endif /* XINERAMA */
+#ifdef XRANDR
+#include <X11/extensions/Xrandr.h>
+#endif /* XRANDR */
+#ifdef XCB
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#endif /* XCB */
 #include <X11/Xft/Xft.h>
 
 #include "drw.h"
@@ -59,6 +73,9 @@
 #define SPTAG(i) 				((1 << LENGTH(tags)) << (i))
 #define SPTAGMASK   			(((1 << LENGTH(scratchpads))-1) << LENGTH(tags))
 #define TEXTW(X)                (drw_fontset_getwidth(drw, (X)) + lrpad)
+#define TEXTLEN                 1024L /* longs read of text properties */
+#define PREWARMLIFE             3000 /* ms a prewarmed scratchpad has to live */
+#define PREWARMTRIES            3 /* shorter lives in a row before giving up */
 
 #define SYSTEM_TRAY_REQUEST_DOCK    0
 /* XEMBED messages */
@@ -79,9 +96,15 @@ enum { SchemeNorm, SchemeSel }; /* color schemes */
 enum { NetSupported, NetWMName, NetWMState, NetWMCheck,
        NetSystemTray, NetSystemTrayOP, NetSystemTrayOrientation, NetSystemTrayOrientationHorz,
        NetWMFullscreen, NetActiveWindow, NetWMWindowType,
-       NetWMWindowTypeDialog, NetClientList, NetClientInfo, NetLast }; /* EWMH atoms */
+       NetWMWindowTypeDialog, NetClientList, NetClientListStacking,
+       NetClientInfo, NetLast }; /* EWMH atoms */
 enum { Manager, Xembed, XembedInfo, XLast }; /* Xembed atoms */
 enum { WMProtocols, WMDelete, WMState, WMTakeFocus, WMLast }; /* default atoms */
+#ifdef XCB
+enum { PropNetName, PropName, PropTrans, PropClass, PropState, PropType,
+       PropNormalHints, PropHints, PropClientInfo, PropWMState,
+       PropLast }; /* properties prefetched for manage() */
+#endif /* XCB */
 enum { ClkTagBar, ClkLtSymbol, ClkStatusText, ClkWinTitle,
        ClkClientWin, ClkRootWin, ClkFollowSymbol, ClkLast }; /* clicks */
 
@@ -112,7 +135,10 @@ struct Client {
 	unsigned int tags;
 	int isfixed, isfloating, isurgent, neverfocus, oldstate, isfullscreen;
 	int alwaysontop;
+	int infodirty;
+	int counted; /* in its monitor's occupancy */
 	Client *next;
+	Client *tnext; /* next in its monitor's tiled */
 	Client *snext;
 	Monitor *mon;
 	Window win;
@@ -144,6 +170,9 @@ struct Monitor {
 	int gappiv;           /* vertical gap between windows */
 	int gappoh;           /* horizontal outer gaps */
 	int gappov;           /* vertical outer gaps */
+	int rate;             /* refresh rate in Hz */
+	Atom rrname;          /* RandR monitor name, None without RandR */
+	int changed;          /* geometry, number or clients, for updatescreen() */
 	unsigned int seltags;
 	unsigned int sellt;
 	unsigned int tagset[2];
@@ -152,6 +181,10 @@ struct Monitor {
 	Client *clients;
 	Client *sel;
 	Client *stack;
+	Client *tiled;         /* visible tiled clients, as of arrangemon() */
+	unsigned int ntiled;
+	unsigned int occ, urg; /* tags with clients, with urgent clients */
+	unsigned int nclients[32], nurgent[32]; /* per tag */
 	Monitor *next;
 	Window barwin;
 	const Layout *lt[2];
@@ -168,6 +201,24 @@ typedef struct {
 	int monitor;
 } Rule;
 
+#ifdef XCB
+typedef struct {
+	Atom prop, type;
+	long len;
+} PropSpec;
+
+typedef struct {
+	Window win;
+	xcb_get_window_attributes_cookie_t attrc;
+	xcb_get_geometry_cookie_t geomc;
+	xcb_get_property_cookie_t propc[PropLast];
+	xcb_get_window_attributes_reply_t *attrs;
+	xcb_get_geometry_reply_t *geom;
+	xcb_get_property_reply_t *props[PropLast];
+	unsigned int got; /* replies taken, bit PropLast for the attributes */
+} Prefetch;
+#endif /* XCB */
+
 typedef struct Systray   Systray;
 struct Systray {
 	Window win;
@@ -175,6 +226,8 @@ struct Systray {
 };
 
 /* function declarations */
+static void account(Client *c, int n);
+static void adoptclients(Monitor *to, Monitor *from);
 static void applyrules(Client *c);
 static int applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact);
 static void arrange(Monitor *m);
@@ -201,15 +254,22 @@ static void drawbars(void);
 static int drawstatusbar(Monitor *m, int bh, char* text);
 static void enternotify(XEvent *e);
 static void expose(XEvent *e);
+static void flushprops(void);
 static void focus(Client *c);
 static void focusin(XEvent *e);
 static void focusmon(const Arg *arg);
 static void focusstack(const Arg *arg);
+static void freeprop(void *p);
 static Atom getatomprop(Client *c, Atom prop);
+static int getattrs(Window w, XWindowAttributes *wa);
+static unsigned char *getprop(Window w, Atom prop, Atom type, long len, Atom *real, int *format, unsigned long *n);
 static int getrootptr(int *x, int *y);
+static int getsizehints(Window w, XSizeHints *size);
 static long getstate(Window w);
 static unsigned int getsystraywidth();
 static int gettextprop(Window w, Atom atom, char *text, unsigned int size);
+static int gettransient(Window w, Window *trans);
+static int getwmhints(Window w, XWMHints *wmh);
 static void grabbuttons(Client *c, int focused);
 static void grabkeys(void);
 static void incnmaster(const Arg *arg);
@@ -222,7 +282,13 @@ static void monocle(Monitor *m);
 static void motionnotify(XEvent *e);
 static void movemouse(const Arg *arg);
 static Client *nexttiled(Client *c);
+static int placemon(Monitor *m, int num, int x, int y, int w, int h);
 static void pop(Client *c);
+static void prewarm(unsigned int i);
+static void prefetch(Window *wins, unsigned int n);
+#ifdef XCB
+static Prefetch *prefetched(Window w);
+#endif /* XCB */
 static void propertynotify(XEvent *e);
 static void quit(const Arg *arg);
 static void raiseclient(Client *c);
@@ -234,7 +300,12 @@ static void resizeclient(Client *c, int x, int y, int w, int h);
 static void resizemouse(const Arg *arg);
 static void resizerequest(XEvent *e);
 static void restack(Monitor *m);
+static int readclient(const char *line, Client *c, int *mon);
+static Monitor *readmon(const char *line);
+static int readpertag(const char *line, Monitor *m);
+static void restorestate(Window *wins, unsigned int num);
 static void run(void);
+static void savestate(void);
 static void scan(void);
 static int sendevent(Window w, Atom proto, int m, long d0, long d1, long d2, long d3, long d4);
 static void sendmon(Client *c, Monitor *m);
@@ -242,6 +313,7 @@ static void setclientstate(Client *c, long state);
 static void setclienttagprop(Client *c);
 static void setfocus(Client *c);
 static void setfullscreen(Client *c, int fullscreen);
+static void settags(Client *c, unsigned int tags, int urgent);
 static void fullscreen(const Arg *arg);
 static void setlayout(const Arg *arg);
 static void setmfact(const Arg *arg);
@@ -251,6 +323,9 @@ static void showhide(Client *c);
 static void sighup(int unused);
 static void sigterm(int unused);
 static void spawn(const Arg *arg);
+#ifdef SPTIME
+static void sptime(unsigned int i, uintmax_t t, const char *how);
+#endif /* SPTIME */
 static Monitor *systraytomon(Monitor *m);
 static void tag(const Arg *arg);
 static void tagtoleft(const Arg *arg);
@@ -265,22 +340,27 @@ static void toggleview(const Arg *arg);
 static void unfocus(Client *c, int setfocus);
 static void unmanage(Client *c, int destroyed);
 static void unmapnotify(XEvent *e);
+static void unprefetch(void);
 static void updatebarpos(Monitor *m);
 static void updatebars(void);
 static void updateclientlist(void);
 static int updategeom(void);
+static void updatescreen(void);
 static void updatenumlockmask(void);
 static void updatesizehints(Client *c);
 static void updatestatus(void);
-static void updatesystray(void);
+static void updatesystray(int force);
 static void updatesystrayicongeom(Client *i, int w, int h);
 static void updatesystrayiconstate(Client *i, XPropertyEvent *ev);
 static void updatetitle(Client *c);
 static void updatewindowtype(Client *c);
 static void updatewmhints(Client *c);
+static uintmax_t usnow(void);
 static void view(const Arg *arg);
 static void viewtoleft(const Arg *arg);
 static void viewtoright(const Arg *arg);
+static void writeclient(FILE *fp, Client *c, int mon);
+static void writemon(FILE *fp, Monitor *m);
 static Client *wintoclient(Window w);
 static Monitor *wintomon(Window w);
 static Client *wintosystrayicon(Window w);
@@ -319,13 +399,29 @@ static void (*handler[LASTEvent]) (XEvent *) = {
 };
 static Atom wmatom[WMLast], netatom[NetLast], xatom[XLast];
 static int restart = 0;
+static int statefd = -1; /* DWM_STATE, taken by main() */
+static int geompending = 0; /* 1: monitors may have changed, 2: the screen was resized */
+#ifdef XRANDR
+static int rrevbase = -1;
+#endif /* XRANDR */
+static unsigned int spwarming = 0; /* SPTAGs of prewarmed scratchpads not mapped yet */
 static int running = 1;
+static int scanning = 0; /* manage() leaves arrange() and focus() to scan() */
 static Cur *cursor[CurLast];
 static Clr **scheme;
 static Display *dpy;
 static Drw *drw;
 static Monitor *mons, *selmon;
 static Window root, wmcheckwin;
+static int clientsdirty, stackingdirty, infodirty; /* see flushprops() */
+static Window *stacking;
+static unsigned int nstacking;
+#ifdef XCB
+static xcb_connection_t *xcon;
+static PropSpec pfspec[PropLast];
+static Prefetch *pf;
+static unsigned int npf;
+#endif /* XCB */
 
 /* configuration, allows nested code to access above variables */
 #include "config.h"
@@ -339,6 +435,20 @@ struct Pertag {
 	int showbars[LENGTH(tags) + 1]; /* display bar for the current tag */
 };
 
+/* the title, class and instance of rules[], taken apart by setup(), and
+ * whether any rule has one, so applyrules() only takes apart those of c */
+static Pattern rulepats[LENGTH(rules)][3];
+static int rulehas[3];
+
+/* when each scratchpad was last prewarmed and how many died young since */
+static struct {
+	uintmax_t started;
+	int fails;
+} spwarm[LENGTH(scratchpads)];
+#ifdef SPTIME
+static uintmax_t sptoggled[LENGTH(scratchpads)]; /* us, 0: not waiting */
+#endif /* SPTIME */
+
 /* compile-time check if all tags fit into an unsigned int bit array. */
 struct NumTags { char limitexceeded[LENGTH(tags) > 31 ? -1 : 1]; };
 
@@ -371,27 +481,91 @@ autostart_exec() {
 }
 
 /* function implementations */
+
+/* count c in the occupancy of its monitor, n = 1, or no longer, n = -1 */
+void
+account(Client *c, int n)
+{
+	Monitor *m = c->mon;
+	unsigned int i;
+
+	c->counted = n > 0;
+	for (i = 0; i < NUMTAGS; i++) {
+		if (!(c->tags & 1 << i))
+			continue;
+		m->nclients[i] += n;
+		m->occ = m->nclients[i] ? m->occ | 1 << i : m->occ & ~(1 << i);
+		if (!c->isurgent)
+			continue;
+		m->nurgent[i] += n;
+		m->urg = m->nurgent[i] ? m->urg | 1 << i : m->urg & ~(1 << i);
+	}
+}
+
+/* move all clients of from to the end of to in one go, keeping their order */
+void
+adoptclients(Monitor *to, Monitor *from)
+{
+	Client *c, **tc, **ts;
+
+	for (tc = &to->clients; *tc; tc = &(*tc)->next);
+	for (ts = &to->stack; *ts; ts = &(*ts)->snext);
+	*tc = from->clients;
+	*ts = from->stack;
+	for (c = from->clients; c; c = c->next) {
+		c->mon = to;
+		if (c->counted)
+			account(c, 1);
+		setclienttagprop(c);
+	}
+	from->clients = from->stack = from->sel = NULL;
+	to->changed = 1;
+}
+
 void
 applyrules(Client *c)
 {
 	const char *class, *instance;
 	unsigned int i;
 	const Rule *r;
+	const Pattern *rp;
+	Pattern tp, cp, ip;
 	Monitor *m;
+#ifdef XCB
+	char *ch;
+	int format;
+	unsigned long n;
+	Atom real;
+#else
 	XClassHint ch = { NULL, NULL };
+#endif /* XCB */
 
 	/* rule matching */
 	c->isfloating = 0;
 	c->tags = 0;
+#ifdef XCB
+	/* WM_CLASS is the instance and the class, both NUL terminated */
+	ch = (char *)getprop(c->win, XA_WM_CLASS, XA_STRING, TEXTLEN, &real, &format, &n);
+	instance = ch && format == 8 ? ch : broken;
+	class    = ch && format == 8 ? ch + MIN(strlen(ch) + 1, n) : broken;
+#else
 	XGetClassHint(dpy, c->win, &ch);
 	class    = ch.res_class ? ch.res_class : broken;
 	instance = ch.res_name  ? ch.res_name  : broken;
+#endif /* XCB */
+	if (rulehas[0])
+		tp = pattern(c->name);
+	if (rulehas[1])
+		cp = pattern(class);
+	if (rulehas[2])
+		ip = pattern(instance);
 
 	for (i = 0; i < LENGTH(rules); i++) {
 		r = &rules[i];
-		if ((!r->title || strstr(c->name, r->title))
-		&& (!r->class || strstr(class, r->class))
-		&& (!r->instance || strstr(instance, r->instance)))
+		rp = rulepats[i];
+		if ((!r->title || contains(c->name, &tp, r->title, &rp[0]))
+		&& (!r->class || contains(class, &cp, r->class, &rp[1]))
+		&& (!r->instance || contains(instance, &ip, r->instance, &rp[2])))
 		{
 			c->isfloating = r->isfloating;
 			c->tags |= r->tags;
@@ -405,10 +579,15 @@ applyrules(Client *c)
 				c->mon = m;
 		}
 	}
+#ifdef XCB
+	if (ch)
+		freeprop(ch);
+#else
 	if (ch.res_class)
 		XFree(ch.res_class);
 	if (ch.res_name)
 		XFree(ch.res_name);
+#endif /* XCB */
 	c->tags = c->tags & TAGMASK ? c->tags & TAGMASK : (c->mon->tagset[c->mon->seltags] & ~SPTAGMASK);
 }
 
@@ -497,6 +676,17 @@ arrange(Monitor *m)
 void
 arrangemon(Monitor *m)
 {
+	Client *c, **tc;
+
+	/* what the layout works on */
+	m->ntiled = 0;
+	for (tc = &m->tiled, c = m->clients; c; c = c->next)
+		if (!c->isfloating && ISVISIBLE(c)) {
+			*tc = c;
+			tc = &c->tnext;
+			m->ntiled++;
+		}
+	*tc = NULL;
 	strncpy(m->ltsymbol, m->lt[m->sellt]->symbol, sizeof m->ltsymbol);
 	if (m->lt[m->sellt]->arrange)
 		m->lt[m->sellt]->arrange(m);
@@ -507,6 +697,7 @@ attach(Client *c)
 {
 	c->next = c->mon->clients;
 	c->mon->clients = c;
+	account(c, 1);
 }
 
 void
@@ -516,6 +707,7 @@ attachbottom(Client *c)
 	c->next = NULL;
 	for (tc = &c->mon->clients; *tc; tc = &(*tc)->next);
 	*tc = c;
+	account(c, 1);
 }
 
 void
@@ -681,7 +873,7 @@ clientmessage(XEvent *e)
 			sendevent(c->win, netatom[Xembed], StructureNotifyMask, CurrentTime, XEMBED_MODALITY_ON, 0 , systray->win, XEMBED_EMBEDDED_VERSION);
 			XSync(dpy, False);
 			resizebarwin(selmon);
-			updatesystray();
+			updatesystray(1);
 			setclientstate(c, NormalState);
 		}
 		return;
@@ -712,10 +904,8 @@ columnlayout(Monitor *m) {
     int w, x;
     Client *c;
 
-    /* Count number of non-floating, visible windows */
-    for (n = 0, c = m->clients; c; c = c->next)
-        if (ISVISIBLE(c) && !c->isfloating)
-            n++;
+    /* Number of non-floating, visible windows */
+    n = m->ntiled;
 
     if (n == 0)
         return;
@@ -725,11 +915,9 @@ columnlayout(Monitor *m) {
     x = m->wx + gappoh;
 
     /* Tile non-floating windows */
-    for (i = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++) {
-        if (!c->isfloating && ISVISIBLE(c)) {
-            resize(c, x, m->wy + gappov, w - (2 * c->bw), m->wh - 2 * gappov - (2 * c->bw), 0);
-            x += w + gappiv;
-        }
+    for (i = 0, c = m->tiled; c; c = c->tnext, i++) {
+        resize(c, x, m->wy + gappov, w - (2 * c->bw), m->wh - 2 * gappov - (2 * c->bw), 0);
+        x += w + gappiv;
     }
 }
 
@@ -755,28 +943,15 @@ configure(Client *c)
 void
 configurenotify(XEvent *e)
 {
-	Monitor *m;
-	Client *c;
 	XConfigureEvent *ev = &e->xconfigure;
-	int dirty;
 
-	/* TODO: updategeom handling sucks, needs to be simplified */
 	if (ev->window == root) {
-		dirty = (sw != ev->width || sh != ev->height);
+		if (sw != ev->width || sh != ev->height)
+			geompending = 2;
+		else
+			geompending = MAX(geompending, 1);
 		sw = ev->width;
 		sh = ev->height;
-		if (updategeom() || dirty) {
-			drw_resize(drw, sw, bh);
-			updatebars();
-			for (m = mons; m; m = m->next) {
-				for (c = m->clients; c; c = c->next)
-					if (c->isfullscreen)
-						resizeclient(c, m->mx, m->my, m->mw, m->mh);
-				resizebarwin(m);
-			}
-			focus(NULL);
-			arrange(NULL);
-		}
 	}
 }
 
@@ -848,6 +1023,7 @@ createmon(void)
 	m->gappiv = gappiv;
 	m->gappoh = gappoh;
 	m->gappov = gappov;
+	m->rate = 60;
 	m->lt[0] = &layouts[0];
 	m->lt[1] = &layouts[1 % LENGTH(layouts)];
 	strncpy(m->ltsymbol, layouts[0].symbol, sizeof m->ltsymbol);
@@ -881,7 +1057,7 @@ destroynotify(XEvent *e)
 	else if ((c = wintosystrayicon(ev->window))) {
 		removesystrayicon(c);
 		resizebarwin(selmon);
-		updatesystray();
+		updatesystray(1);
 	}
 }
 
@@ -892,6 +1068,7 @@ detach(Client *c)
 
 	for (tc = &c->mon->clients; *tc && *tc != c; tc = &(*tc)->next);
 	*tc = c->next;
+	account(c, -1);
 }
 
 void
@@ -925,6 +1102,8 @@ dirtomon(int dir)
 
 int
 drawstatusbar(Monitor *m, int bh, char* stext) {
+	static char laststext[1024];
+	static int laststextw;
 	int ret, i, w, x, len;
 	short isCode = 0;
 	char *text;
@@ -936,30 +1115,36 @@ drawstatusbar(Monitor *m, int bh, char* stext) {
 	p = text;
 	memcpy(text, stext, len);
 
-	/* compute width of the status text */
-	w = 0;
-	i = -1;
-	while (text[++i]) {
-		if (text[i] == '^') {
-			if (!isCode) {
-				isCode = 1;
-				text[i] = '\0';
-				w += TEXTW(text) - lrpad;
-				text[i] = '^';
-				if (text[++i] == 'f')
-					w += atoi(text + ++i);
-			} else {
-				isCode = 0;
-				text = text + i + 1;
-				i = -1;
+	/* compute width of the status text, unless it is the same as before */
+	if (!strcmp(stext, laststext)) {
+		w = laststextw;
+	} else {
+		w = 0;
+		i = -1;
+		while (text[++i]) {
+			if (text[i] == '^') {
+				if (!isCode) {
+					isCode = 1;
+					text[i] = '\0';
+					w += TEXTW(text) - lrpad;
+					text[i] = '^';
+					if (text[++i] == 'f')
+						w += atoi(text + ++i);
+				} else {
+					isCode = 0;
+					text = text + i + 1;
+					i = -1;
+				}
 			}
 		}
+		if (!isCode)
+			w += TEXTW(text) - lrpad;
+		else
+			isCode = 0;
+		text = p;
+		memcpy(laststext, stext, len);
+		laststextw = w;
 	}
-	if (!isCode)
-		w += TEXTW(text) - lrpad;
-	else
-		isCode = 0;
-	text = p;
 
 	w += 2; /* 1px padding on both sides */
 	ret = m->ww - w;
@@ -1038,8 +1223,7 @@ drawbar(Monitor *m)
 	int x, w, tw = 0, stw = 0;
 	int boxs = drw->fonts->h / 9;
 	int boxw = drw->fonts->h / 6 + 2;
-	unsigned int i, occ = 0, urg = 0;
-	Client *c;
+	unsigned int i, occ = m->occ, urg = m->urg;
 
 	if (!m->showbar)
 		return;
@@ -1053,11 +1237,6 @@ drawbar(Monitor *m)
 	}
 
 	resizebarwin(m);
-	for (c = m->clients; c; c = c->next) {
-		occ |= c->tags;
-		if (c->isurgent)
-			urg |= c->tags;
-	}
 	x = 0;
 	for (i = 0; i < LENGTH(tags); i++) {
 		w = TEXTW(tags[i]);
@@ -1129,10 +1308,64 @@ expose(XEvent *e)
 	if (ev->count == 0 && (m = wintomon(ev->window))) {
 		drawbar(m);
 		if (m == selmon)
-			updatesystray();
+			updatesystray(1);
 	}
 }
 
+/* Write the EWMH properties that changed while handling the last batch of
+ * events, each once: listeners on root see one PropertyNotify per list. */
+void
+flushprops(void)
+{
+	Client *c;
+	Monitor *m;
+	Window *wins, *tree, d1, d2;
+	unsigned int i, j, n, nt;
+	long data[2];
+
+	for (m = mons; infodirty && m; m = m->next)
+		for (c = m->clients; c; c = c->next)
+			if (c->infodirty) {
+				data[0] = c->tags;
+				data[1] = c->mon->num;
+				XChangeProperty(dpy, c->win, netatom[NetClientInfo], XA_CARDINAL, 32,
+					PropModeReplace, (unsigned char *) data, 2);
+				c->infodirty = 0;
+			}
+	infodirty = 0;
+	if (!clientsdirty && !stackingdirty)
+		return;
+
+	for (n = 0, m = mons; m; m = m->next)
+		for (c = m->clients; c; c = c->next, n++);
+	wins = ecalloc(MAX(n, 1), sizeof(Window));
+	if (clientsdirty) {
+		for (i = 0, m = mons; m; m = m->next)
+			for (c = m->clients; c; c = c->next)
+				wins[i++] = c->win;
+		XChangeProperty(dpy, root, netatom[NetClientList], XA_WINDOW, 32,
+			PropModeReplace, (unsigned char *) wins, n);
+	}
+	/* bottom to top as the server has them, restack() and raiseclient()
+	 * leave floating windows where they were raised */
+	n = 0;
+	if (XQueryTree(dpy, root, &d1, &d2, &tree, &nt)) {
+		for (j = 0; j < nt; j++)
+			if (wintoclient(tree[j]))
+				wins[n++] = tree[j];
+		XFree(tree);
+	}
+	if (n != nstacking || (n && memcmp(wins, stacking, n * sizeof(Window)))) {
+		XChangeProperty(dpy, root, netatom[NetClientListStacking], XA_WINDOW, 32,
+			PropModeReplace, (unsigned char *) wins, n);
+		free(stacking);
+		stacking = wins;
+		nstacking = n;
+	} else
+		free(wins);
+	clientsdirty = stackingdirty = 0;
+}
+
 void
 focus(Client *c)
 {
@@ -1210,6 +1443,35 @@ focusstack(const Arg *arg)
 	while (XCheckMaskEvent(dpy, EnterWindowMask, &xev));
 }
 
+int
+getattrs(Window w, XWindowAttributes *wa)
+{
+#ifdef XCB
+	Prefetch *f;
+
+	if ((f = prefetched(w))) {
+		if (!(f->got & 1 << PropLast)) {
+			f->attrs = xcb_get_window_attributes_reply(xcon, f->attrc, NULL);
+			f->geom = xcb_get_geometry_reply(xcon, f->geomc, NULL);
+			f->got |= 1 << PropLast;
+		}
+		if (!f->attrs || !f->geom)
+			return 0;
+		/* only what scan(), maprequest() and manage() look at */
+		memset(wa, 0, sizeof *wa);
+		wa->x = f->geom->x;
+		wa->y = f->geom->y;
+		wa->width = f->geom->width;
+		wa->height = f->geom->height;
+		wa->border_width = f->geom->border_width;
+		wa->map_state = f->attrs->map_state;
+		wa->override_redirect = f->attrs->override_redirect;
+		return 1;
+	}
+#endif /* XCB */
+	return XGetWindowAttributes(dpy, w, wa);
+}
+
 Atom
 getatomprop(Client *c, Atom prop)
 {
@@ -1224,12 +1486,11 @@ getatomprop(Client *c, Atom prop)
 	if (prop == xatom[XembedInfo])
 		req = xatom[XembedInfo];
 
-	if (XGetWindowProperty(dpy, c->win, prop, 0L, sizeof atom, False, req,
-		&da, &di, &dl, &dl, &p) == Success && p) {
+	if ((p = getprop(c->win, prop, req, sizeof atom, &da, &di, &dl))) {
 		atom = *(Atom *)p;
 		if (da == xatom[XembedInfo] && dl == 2)
 			atom = ((Atom *)p)[1];
-		XFree(p);
+		freeprop(p);
 	}
 	return atom;
 }
@@ -1244,21 +1505,135 @@ getrootptr(int *x, int *y)
 	return XQueryPointer(dpy, root, &dummy, &dummy, x, y, &di, &di, &dui);
 }
 
+/* XGetWindowProperty(), answered from prefetched replies where there are
+ * some. Returns NULL for no data, which is freed with freeprop() otherwise. */
+unsigned char *
+getprop(Window w, Atom prop, Atom type, long len, Atom *real, int *format, unsigned long *n)
+{
+	unsigned char *p = NULL;
+	unsigned long extra;
+#ifdef XCB
+	xcb_get_property_reply_t *r;
+	Prefetch *f;
+	uint32_t *v32;
+	uint16_t *v16;
+	unsigned long i;
+	int j;
+
+	for (j = 0, f = prefetched(w); f && j < PropLast; j++)
+		if (pfspec[j].prop == prop && pfspec[j].type == type && pfspec[j].len == len)
+			break;
+	if (f && j < PropLast) {
+		if (!(f->got & 1 << j)) {
+			f->props[j] = xcb_get_property_reply(xcon, f->propc[j], NULL);
+			f->got |= 1 << j;
+		}
+		*n = 0;
+		if (!(r = f->props[j]))
+			return NULL;
+		*real = r->type;
+		*format = r->format;
+		if (!r->value_len)
+			return NULL;
+		/* in the layout Xlib hands out: longs and shorts, strings terminated */
+		switch (r->format) {
+		case 32:
+			p = ecalloc(r->value_len, sizeof(long));
+			for (i = 0, v32 = xcb_get_property_value(r); i < r->value_len; i++)
+				((long *)p)[i] = v32[i];
+			break;
+		case 16:
+			p = ecalloc(r->value_len, sizeof(short));
+			for (i = 0, v16 = xcb_get_property_value(r); i < r->value_len; i++)
+				((short *)p)[i] = v16[i];
+			break;
+		default:
+			p = ecalloc(r->value_len + 1, 1);
+			memcpy(p, xcb_get_property_value(r), r->value_len);
+			break;
+		}
+		*n = r->value_len;
+		return p;
+	}
+#endif /* XCB */
+	if (XGetWindowProperty(dpy, w, prop, 0L, len, False, type,
+		real, format, n, &extra, &p) != Success) {
+		*n = 0;
+		return NULL;
+	}
+	if (p && !*n) {
+		XFree(p);
+		p = NULL;
+	}
+	return p;
+}
+
+/* The prefetched properties are ecalloc() copies while the others come from
+ * Xlib, which both go to free(): XFree() is just that in libX11. */
+void
+freeprop(void *p)
+{
+	XFree(p);
+}
+
+/* With XCB the ICCCM hints are decoded from the prefetched replies, see
+ * getprop(), else Xlib does it. */
+int
+getsizehints(Window w, XSizeHints *size)
+{
+#ifdef XCB
+	long *p;
+	int format, ok = 0;
+	unsigned long n;
+	Atom real;
+
+	/* as XGetWMNormalHints(), pre-ICCCM hints lack the base size */
+	memset(size, 0, sizeof *size);
+	if (!(p = (long *)getprop(w, XA_WM_NORMAL_HINTS, XA_WM_SIZE_HINTS, 18L, &real, &format, &n)))
+		return 0;
+	if (real == XA_WM_SIZE_HINTS && format == 32 && n >= 15) {
+		size->flags = p[0] & (USPosition|USSize|PAllHints|(n >= 18 ? PBaseSize|PWinGravity : 0));
+		size->x = p[1];
+		size->y = p[2];
+		size->width = p[3];
+		size->height = p[4];
+		size->min_width = p[5];
+		size->min_height = p[6];
+		size->max_width = p[7];
+		size->max_height = p[8];
+		size->width_inc = p[9];
+		size->height_inc = p[10];
+		size->min_aspect.x = p[11];
+		size->min_aspect.y = p[12];
+		size->max_aspect.x = p[13];
+		size->max_aspect.y = p[14];
+		size->base_width = n >= 18 ? p[15] : 0;
+		size->base_height = n >= 18 ? p[16] : 0;
+		size->win_gravity = n >= 18 ? p[17] : 0;
+		ok = 1;
+	}
+	freeprop(p);
+	return ok;
+#else
+	long msize;
+
+	return XGetWMNormalHints(dpy, w, size, &msize);
+#endif /* XCB */
+}
+
 long
 getstate(Window w)
 {
 	int format;
 	long result = -1;
-	unsigned char *p = NULL;
-	unsigned long n, extra;
+	unsigned char *p;
+	unsigned long n;
 	Atom real;
 
-	if (XGetWindowProperty(dpy, w, wmatom[WMState], 0L, 2L, False, wmatom[WMState],
-		&real, &format, &n, &extra, (unsigned char **)&p) != Success)
-		return -1;
-	if (n != 0)
+	if ((p = getprop(w, wmatom[WMState], wmatom[WMState], 2L, &real, &format, &n))) {
 		result = *p;
-	XFree(p);
+		freeprop(p);
+	}
 	return result;
 }
 
@@ -1282,7 +1657,8 @@ gettextprop(Window w, Atom atom, char *text, unsigned int size)
 	if (!text || size == 0)
 		return 0;
 	text[0] = '\0';
-	if (!XGetTextProperty(dpy, w, &name, atom) || !name.nitems)
+	if (!(name.value = getprop(w, atom, AnyPropertyType, TEXTLEN,
+		&name.encoding, &name.format, &name.nitems)))
 		return 0;
 	if (name.encoding == XA_STRING) {
 		strncpy(text, (char *)name.value, size - 1);
@@ -1291,10 +1667,71 @@ gettextprop(Window w, Atom atom, char *text, unsigned int size)
 		XFreeStringList(list);
 	}
 	text[size - 1] = '\0';
-	XFree(name.value);
+	freeprop(name.value);
 	return 1;
 }
 
+int
+gettransient(Window w, Window *trans)
+{
+#ifdef XCB
+	long *p;
+	int format;
+	unsigned long n;
+	Atom real;
+
+	*trans = None;
+	if (!(p = (long *)getprop(w, XA_WM_TRANSIENT_FOR, XA_WINDOW, 1L, &real, &format, &n)))
+		return 0;
+	if (format == 32)
+		*trans = *p;
+	freeprop(p);
+	return format == 32;
+#else
+	*trans = None;
+	return XGetTransientForHint(dpy, w, trans);
+#endif /* XCB */
+}
+
+int
+getwmhints(Window w, XWMHints *wmh)
+{
+#ifdef XCB
+	long *p;
+	int format, ok = 0;
+	unsigned long n;
+	Atom real;
+
+	/* as XGetWMHints(), the window group came later */
+	if (!(p = (long *)getprop(w, XA_WM_HINTS, XA_WM_HINTS, 9L, &real, &format, &n)))
+		return 0;
+	if (real == XA_WM_HINTS && format == 32 && n >= 8) {
+		wmh->flags = p[0];
+		wmh->input = p[1];
+		wmh->initial_state = p[2];
+		wmh->icon_pixmap = p[3];
+		wmh->icon_window = p[4];
+		wmh->icon_x = p[5];
+		wmh->icon_y = p[6];
+		wmh->icon_mask = p[7];
+		wmh->window_group = n >= 9 ? p[8] : 0;
+		if (n < 9)
+			wmh->flags &= ~WindowGroupHint;
+		ok = 1;
+	}
+	freeprop(p);
+	return ok;
+#else
+	XWMHints *p;
+
+	if (!(p = XGetWMHints(dpy, w)))
+		return 0;
+	*wmh = *p;
+	XFree(p);
+	return 1;
+#endif /* XCB */
+}
+
 void
 grabbuttons(Client *c, int focused)
 {
@@ -1403,6 +1840,9 @@ manage(Window w, XWindowAttributes *wa)
 	Window trans = None;
 	XWindowChanges wc;
 	XEvent xev;
+#ifdef SPTIME
+	unsigned int i;
+#endif /* SPTIME */
 
 	c = ecalloc(1, sizeof(Client));
 	c->win = w;
@@ -1414,7 +1854,7 @@ manage(Window w, XWindowAttributes *wa)
 	c->oldbw = wa->border_width;
 
 	updatetitle(c);
-	if (XGetTransientForHint(dpy, w, &trans) && (t = wintoclient(trans))) {
+	if (gettransient(w, &trans) && (t = wintoclient(trans))) {
 		c->mon = t->mon;
 		c->tags = t->tags;
 		c->alwaysontop = 1;
@@ -1440,23 +1880,25 @@ manage(Window w, XWindowAttributes *wa)
 	updatewmhints(c);
 	{
 		int format;
-		unsigned long *data, n, extra;
+		unsigned long *data, n;
 		Monitor *m;
 		Atom atom;
-		if (XGetWindowProperty(dpy, c->win, netatom[NetClientInfo], 0L, 2L, False, XA_CARDINAL,
-				&atom, &format, &n, &extra, (unsigned char **)&data) == Success && n == 2) {
-			c->tags = *data;
-			for (m = mons; m; m = m->next) {
-				if (m->num == *(data+1)) {
-					c->mon = m;
-					break;
+		if ((data = (unsigned long *)getprop(c->win, netatom[NetClientInfo], XA_CARDINAL, 2L,
+				&atom, &format, &n))) {
+			if (n == 2) {
+				c->tags = *data;
+				for (m = mons; m; m = m->next) {
+					if (m->num == *(data+1)) {
+						c->mon = m;
+						break;
+					}
 				}
 			}
+			freeprop(data);
 		}
-		if (n > 0)
-			XFree(data);
 	}
 	setclienttagprop(c);
+	spwarming &= ~c->tags;
 
 	c->x = c->mon->mx + (c->mon->mw - WIDTH(c)) / 2;
 	c->y = c->mon->my + (c->mon->mh - HEIGHT(c)) / 2;
@@ -1468,17 +1910,27 @@ manage(Window w, XWindowAttributes *wa)
 		XRaiseWindow(dpy, c->win);
 	attachbottom(c);
 	attachstack(c);
-	XChangeProperty(dpy, root, netatom[NetClientList], XA_WINDOW, 32, PropModeAppend,
-		(unsigned char *) &(c->win), 1);
+	updateclientlist();
 	XMoveResizeWindow(dpy, c->win, c->x + 2 * sw, c->y, c->w, c->h); /* some windows require this */
 	setclientstate(c, NormalState);
 	if (c->mon == selmon)
 		unfocus(selmon->sel, 0);
 	c->mon->sel = c;
+	if (scanning) {
+		XMapWindow(dpy, c->win);
+		return;
+	}
 	arrange(c->mon);
 	XMapWindow(dpy, c->win);
 	focus(NULL);
 	while (XCheckMaskEvent(dpy, EnterWindowMask, &xev));
+#ifdef SPTIME
+	for (i = 0; i < LENGTH(scratchpads); i++)
+		if (c->tags & SPTAG(i) && sptoggled[i]) {
+			sptime(i, sptoggled[i], "started");
+			sptoggled[i] = 0;
+		}
+#endif /* SPTIME */
 }
 
 void
@@ -1501,14 +1953,16 @@ maprequest(XEvent *e)
 	if ((i = wintosystrayicon(ev->window))) {
 		sendevent(i->win, netatom[Xembed], StructureNotifyMask, CurrentTime, XEMBED_WINDOW_ACTIVATE, 0, systray->win, XEMBED_EMBEDDED_VERSION);
 		resizebarwin(selmon);
-		updatesystray();
+		updatesystray(1);
 	}
 
 
-	if (!XGetWindowAttributes(dpy, ev->window, &wa) || wa.override_redirect)
+	if (wintoclient(ev->window))
 		return;
-	if (!wintoclient(ev->window))
+	prefetch(&ev->window, 1);
+	if (getattrs(ev->window, &wa) && !wa.override_redirect)
 		manage(ev->window, &wa);
+	unprefetch();
 }
 
 void
@@ -1522,7 +1976,7 @@ monocle(Monitor *m)
 			n++;
 	if (n > 0) /* override layout symbol */
 		snprintf(m->ltsymbol, sizeof m->ltsymbol, "[%d]", n);
-	for (c = nexttiled(m->clients); c; c = nexttiled(c->next))
+	for (c = m->tiled; c; c = c->tnext)
 		resize(c, m->wx, m->wy, m->ww - 2 * c->bw, m->wh - 2 * c->bw, 0);
 }
 
@@ -1573,7 +2027,7 @@ movemouse(const Arg *arg)
 			handler[ev.type](&ev);
 			break;
 		case MotionNotify:
-			if ((ev.xmotion.time - lasttime) <= (1000 / 60))
+			if ((ev.xmotion.time - lasttime) <= (1000 / c->mon->rate))
 				continue;
 			lasttime = ev.xmotion.time;
 
@@ -1610,6 +2064,29 @@ nexttiled(Client *c)
 	return c;
 }
 
+/* give m the number num and the geometry x, y, w, h, returns whether
+ * anything changed, which marks m for updatescreen() */
+int
+placemon(Monitor *m, int num, int x, int y, int w, int h)
+{
+	Client *c;
+
+	if (m->num == num && m->mx == x && m->my == y && m->mw == w && m->mh == h)
+		return 0;
+	if (m->num != num) {
+		m->num = num;
+		for (c = m->clients; c; c = c->next)
+			setclienttagprop(c);
+	}
+	m->mx = m->wx = x;
+	m->my = m->wy = y;
+	m->mw = m->ww = w;
+	m->mh = m->wh = h;
+	updatebarpos(m);
+	m->changed = 1;
+	return 1;
+}
+
 void
 pop(Client *c)
 {
@@ -1619,6 +2096,77 @@ pop(Client *c)
 	arrange(c->mon);
 }
 
+/* start scratchpad i in the background, it stays hidden on its tag until
+ * togglescratch() shows it */
+void
+prewarm(unsigned int i)
+{
+	Arg sparg = {.v = scratchpads[i].cmd};
+	Monitor *m;
+	Client *c;
+
+	for (m = mons; m; m = m->next)
+		for (c = m->clients; c; c = c->next)
+			if (c->tags & SPTAG(i))
+				return;
+	/* one that keeps exiting is only started by togglescratch() */
+	if (spwarm[i].fails >= PREWARMTRIES)
+		return;
+	if (spwarm[i].started && usnow() - spwarm[i].started < PREWARMLIFE * 1000) {
+		if (++spwarm[i].fails == PREWARMTRIES) {
+			fprintf(stderr, "dwm: scratchpad %s keeps exiting, not prewarming it\n",
+			        scratchpads[i].name);
+			return;
+		}
+	} else {
+		spwarm[i].fails = 0;
+	}
+	spwarm[i].started = usnow();
+	/* where it was shown last, it would show up right away */
+	for (m = mons; m; m = m->next)
+		if (m->tagset[m->seltags] & ~SPTAG(i))
+			m->tagset[m->seltags] &= ~SPTAG(i);
+	spwarming |= SPTAG(i);
+	spawn(&sparg);
+}
+
+/* ask for the attributes and what manage() reads of all wins at once, so
+ * waiting for the replies takes a single round trip */
+void
+prefetch(Window *wins, unsigned int n)
+{
+#ifdef XCB
+	unsigned int i;
+	int j;
+
+	unprefetch();
+	pf = ecalloc(n, sizeof(Prefetch));
+	npf = n;
+	for (i = 0; i < n; i++) {
+		pf[i].win = wins[i];
+		pf[i].attrc = xcb_get_window_attributes(xcon, wins[i]);
+		pf[i].geomc = xcb_get_geometry(xcon, wins[i]);
+		for (j = 0; j < PropLast; j++)
+			pf[i].propc[j] = xcb_get_property(xcon, 0, wins[i], pfspec[j].prop,
+				pfspec[j].type, 0, pfspec[j].len);
+	}
+	xcb_flush(xcon);
+#endif /* XCB */
+}
+
+#ifdef XCB
+Prefetch *
+prefetched(Window w)
+{
+	unsigned int i;
+
+	for (i = 0; i < npf; i++)
+		if (pf[i].win == w)
+			return &pf[i];
+	return NULL;
+}
+#endif /* XCB */
+
 void
 propertynotify(XEvent *e)
 {
@@ -1634,7 +2182,7 @@ propertynotify(XEvent *e)
 		else
 			updatesystrayiconstate(c, ev);
 		resizebarwin(selmon);
-		updatesystray();
+		updatesystray(1);
 	}
 
     if ((ev->window == root) && (ev->atom == XA_WM_NAME))
@@ -1645,7 +2193,7 @@ propertynotify(XEvent *e)
 		switch(ev->atom) {
 		default: break;
 		case XA_WM_TRANSIENT_FOR:
-			if (!c->isfloating && (XGetTransientForHint(dpy, c->win, &trans)) &&
+			if (!c->isfloating && (gettransient(c->win, &trans)) &&
 				(c->isfloating = (wintoclient(trans)) != NULL))
 				arrange(c->mon);
 			break;
@@ -1797,7 +2345,7 @@ tagtoleft(const Arg *arg) {
 	if(selmon->sel != NULL
 	&& __builtin_popcount(selmon->tagset[selmon->seltags] & TAGMASK) == 1
 	&& selmon->tagset[selmon->seltags] > 1) {
-		selmon->sel->tags >>= 1;
+		settags(selmon->sel, selmon->sel->tags >> 1, selmon->sel->isurgent);
 		focus(NULL);
 		arrange(selmon);
 	}
@@ -1808,7 +2356,7 @@ tagtoright(const Arg *arg) {
 	if(selmon->sel != NULL
 	&& __builtin_popcount(selmon->tagset[selmon->seltags] & TAGMASK) == 1
 	&& selmon->tagset[selmon->seltags] & (TAGMASK >> 1)) {
-		selmon->sel->tags <<= 1;
+		settags(selmon->sel, selmon->sel->tags << 1, selmon->sel->isurgent);
 		focus(NULL);
 		arrange(selmon);
 	}
@@ -1843,7 +2391,7 @@ resizemouse(const Arg *arg)
 			handler[ev.type](&ev);
 			break;
 		case MotionNotify:
-			if ((ev.xmotion.time - lasttime) <= (1000 / 60))
+			if ((ev.xmotion.time - lasttime) <= (1000 / c->mon->rate))
 				continue;
 			lasttime = ev.xmotion.time;
 
@@ -1880,7 +2428,7 @@ resizerequest(XEvent *e)
 	if ((i = wintosystrayicon(ev->window))) {
 		updatesystrayicongeom(i, ev->width, ev->height);
 		resizebarwin(selmon);
-		updatesystray();
+		updatesystray(1);
 	}
 }
 
@@ -1895,6 +2443,7 @@ restack(Monitor *m)
 	drawbar(m);
 	if (!m->sel)
 		return;
+	stackingdirty = 1;
 
 	raised = (focusedontoptiled || m->sel->isfloating ? m->sel : NULL);
 
@@ -1915,15 +2464,226 @@ restack(Monitor *m)
 	while (XCheckMaskEvent(dpy, EnterWindowMask, &ev));
 }
 
+/* the 'c' line of a client, see writeclient(); c->tags is left unmasked */
+int
+readclient(const char *line, Client *c, int *mon)
+{
+	return sscanf(line, "c %lu %d %u %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d",
+	    &c->win, mon, &c->tags, &c->x, &c->y, &c->w, &c->h, &c->oldx,
+	    &c->oldy, &c->oldw, &c->oldh, &c->bw, &c->oldbw, &c->isfloating,
+	    &c->isfullscreen, &c->oldstate, &c->alwaysontop, &c->isurgent) == 18;
+}
+
+/* apply the 'm' line of a monitor, see writemon(), to the one of mons with
+ * its number, which is returned */
+Monitor *
+readmon(const char *line)
+{
+	char wf;
+	int mon, n, sb, tb, lt[2], g[4];
+	unsigned int i, st, t[2], sl, cur, prev;
+	float f;
+	Monitor *m;
+
+	if (sscanf(line, "m %d %u %u %u %u %d %d %f %d %d %d %d %d %d %d %c %u %u",
+	    &mon, &st, &t[0], &t[1], &sl, &lt[0], &lt[1], &f, &n, &sb, &tb,
+	    &g[0], &g[1], &g[2], &g[3], &wf, &cur, &prev) != 18)
+		return NULL;
+	for (m = mons; m && m->num != mon; m = m->next);
+	if (!m)
+		return NULL;
+	m->seltags = st & 1;
+	m->tagset[0] = t[0] & TAGMASK ? t[0] & TAGMASK : m->tagset[0];
+	m->tagset[1] = t[1] & TAGMASK ? t[1] & TAGMASK : m->tagset[1];
+	m->sellt = sl & 1;
+	for (i = 0; i < 2; i++)
+		if (lt[i] >= 0 && lt[i] < (int)LENGTH(layouts))
+			m->lt[i] = &layouts[lt[i]];
+	m->mfact = f;
+	m->nmaster = n;
+	m->showbar = sb;
+	m->topbar = tb;
+	m->gappih = g[0];
+	m->gappiv = g[1];
+	m->gappoh = g[2];
+	m->gappov = g[3];
+	m->wfsymbol[0] = wf;
+	if (cur <= LENGTH(tags) && prev <= LENGTH(tags)) {
+		m->pertag->curtag = cur;
+		m->pertag->prevtag = prev;
+	}
+	updatebarpos(m);
+	return m;
+}
+
+/* apply a 'p' line, see writemon(), to m */
+int
+readpertag(const char *line, Monitor *m)
+{
+	int n, sb, lt[2];
+	unsigned int i, sl;
+	float f;
+
+	if (sscanf(line, "p %u %d %f %u %d %d %d", &i, &n, &f, &sl,
+	    &lt[0], &lt[1], &sb) != 7 || i > LENGTH(tags))
+		return 0;
+	m->pertag->nmasters[i] = n;
+	m->pertag->mfacts[i] = f;
+	m->pertag->sellts[i] = sl & 1;
+	for (n = 0; n < 2; n++)
+		if (lt[n] >= 0 && lt[n] < (int)LENGTH(layouts))
+			m->pertag->ltidxs[i][n] = &layouts[lt[n]];
+	m->pertag->showbars[i] = sb;
+	return 1;
+}
+
+/* take over what the dwm before an in-place restart handed down in
+ * DWM_STATE, see savestate(). Clients are restored without rules or the
+ * map dance of manage(), anything that changed meanwhile is left to scan(). */
+void
+restorestate(Window *wins, unsigned int num)
+{
+	char line[256];
+	int mon, fd;
+	unsigned int i, ns = 0;
+	Client *c;
+	Monitor *m = NULL;
+	Window win, *stack;
+	XWindowAttributes wa;
+	XWindowChanges wc;
+	FILE *fp;
+
+	if ((fd = statefd) < 0)
+		return;
+	statefd = -1;
+	if (lseek(fd, 0, SEEK_SET) < 0 || !(fp = fdopen(fd, "r"))) {
+		close(fd);
+		return;
+	}
+	stack = ecalloc(num + 1, sizeof(Window));
+	while (fgets(line, sizeof line, fp)) {
+		switch (line[0]) {
+		case 'm':
+			m = readmon(line);
+			break;
+		case 'p':
+			if (m)
+				readpertag(line, m);
+			break;
+		case 'c':
+			c = ecalloc(1, sizeof(Client));
+			if (!readclient(line, c, &mon)) {
+				free(c);
+				break;
+			}
+			for (i = 0; i < num && wins[i] != c->win; i++);
+			if (i == num || wintoclient(c->win) || !getattrs(c->win, &wa)
+			|| wa.override_redirect || wa.map_state != IsViewable) {
+				free(c);
+				break;
+			}
+			for (c->mon = mons; c->mon && c->mon->num != mon; c->mon = c->mon->next);
+			if (!c->mon)
+				c->mon = mons;
+			c->tags = c->tags & TAGMASK ? c->tags & TAGMASK : c->mon->tagset[c->mon->seltags];
+			/* borderpx may have changed with the binary, as in manage() */
+			if (c->isfullscreen)
+				c->oldbw = borderpx;
+			else
+				c->bw = borderpx;
+			wc.border_width = c->bw;
+			XConfigureWindow(dpy, c->win, CWBorderWidth, &wc);
+			XSetWindowBorder(dpy, c->win, scheme[SchemeNorm][ColBorder].pixel);
+			configure(c);
+			updatetitle(c);
+			updatesizehints(c);
+			updatewmhints(c);
+			XSelectInput(dpy, c->win, EnterWindowMask|FocusChangeMask|PropertyChangeMask|StructureNotifyMask);
+			grabbuttons(c, 0);
+			attachbottom(c);
+			attachstack(c);
+			spwarming &= ~c->tags;
+			break;
+		case 's':
+			if (ns < num && sscanf(line, "s %lu", &win) == 1)
+				stack[ns++] = win;
+			break;
+		case 'S':
+			if (sscanf(line, "S %d", &mon) == 1)
+				for (m = mons; m; m = m->next)
+					if (m->num == mon)
+						selmon = m;
+			break;
+		}
+	}
+	fclose(fp);
+	/* the stack was handed down top first */
+	while (ns--)
+		if ((c = wintoclient(stack[ns]))) {
+			detachstack(c);
+			attachstack(c);
+		}
+	free(stack);
+	for (m = mons; m; m = m->next)
+		for (m->sel = m->stack; m->sel && !ISVISIBLE(m->sel); m->sel = m->sel->snext);
+	updateclientlist();
+	arrange(NULL);
+	focus(NULL);
+}
+
 void
 run(void)
 {
 	XEvent ev;
 	/* main event loop */
+	flushprops();
 	XSync(dpy, False);
-	while (running && !XNextEvent(dpy, &ev))
+	while (running && !XNextEvent(dpy, &ev)) {
+#ifdef XRANDR
+		if (rrevbase >= 0 && (ev.type == rrevbase + RRScreenChangeNotify
+		|| ev.type == rrevbase + RRNotify)) {
+			XRRUpdateConfiguration(&ev);
+			geompending = MAX(geompending, 1);
+		} else
+#endif /* XRANDR */
 		if (handler[ev.type])
 			handler[ev.type](&ev); /* call handler */
+		if (!XPending(dpy)) { /* done with this batch */
+			updatescreen();
+			flushprops();
+		}
+	}
+	flushprops();
+}
+
+/* hand the state down to the next dwm on an in-place restart, in a
+ * memfd named by DWM_STATE; read back by restorestate() */
+void
+savestate(void)
+{
+#ifdef __linux__
+	char env[16];
+	int fd;
+	Monitor *m;
+	FILE *fp;
+
+	if ((fd = syscall(SYS_memfd_create, "dwm", MFD_CLOEXEC)) < 0)
+		return;
+	if (!(fp = fdopen(fd, "w"))) {
+		close(fd);
+		return;
+	}
+	for (m = mons; m; m = m->next)
+		writemon(fp, m);
+	fprintf(fp, "S %d\n", selmon->num);
+	if (fflush(fp) == EOF)
+		return;
+	/* only for the dwm exec()ed next, which closes it on exec again */
+	if (fcntl(fd, F_SETFD, 0) < 0)
+		return;
+	snprintf(env, sizeof env, "%d", fd);
+	setenv("DWM_STATE", env, 1);
+#endif /* __linux__ */
 }
 
 void
@@ -1932,24 +2692,36 @@ scan(void)
 	unsigned int i, num;
 	Window d1, d2, *wins = NULL;
 	XWindowAttributes wa;
+	Monitor *m;
+	XEvent xev;
 
 	if (XQueryTree(dpy, root, &d1, &d2, &wins, &num)) {
+		prefetch(wins, num);
+		restorestate(wins, num);
+		scanning = 1;
 		for (i = 0; i < num; i++) {
-			if (!XGetWindowAttributes(dpy, wins[i], &wa)
-			|| wa.override_redirect || XGetTransientForHint(dpy, wins[i], &d1))
+			if (wintoclient(wins[i]) || !getattrs(wins[i], &wa)
+			|| wa.override_redirect || gettransient(wins[i], &d1))
 				continue;
 			if (wa.map_state == IsViewable || getstate(wins[i]) == IconicState)
 				manage(wins[i], &wa);
 		}
 		for (i = 0; i < num; i++) { /* now the transients */
-			if (!XGetWindowAttributes(dpy, wins[i], &wa))
+			if (wintoclient(wins[i]) || !getattrs(wins[i], &wa))
 				continue;
-			if (XGetTransientForHint(dpy, wins[i], &d1)
+			if (gettransient(wins[i], &d1)
 			&& (wa.map_state == IsViewable || getstate(wins[i]) == IconicState))
 				manage(wins[i], &wa);
 		}
+		scanning = 0;
+		unprefetch();
 		if (wins)
 			XFree(wins);
+		/* once for all windows instead of a restack and XSync() each */
+		for (m = mons; m; m = m->next)
+			arrange(m);
+		focus(NULL);
+		while (XCheckMaskEvent(dpy, EnterWindowMask, &xev));
 	}
 }
 
@@ -2097,10 +2869,27 @@ setmfact(const Arg *arg)
 	arrange(selmon);
 }
 
+/* change the tags or urgency of c, keeping its monitor's occupancy */
+void
+settags(Client *c, unsigned int tags, int urgent)
+{
+	int counted = c->counted;
+
+	if (counted)
+		account(c, -1);
+	c->tags = tags;
+	c->isurgent = urgent;
+	if (counted)
+		account(c, 1);
+}
+
 void
 setup(void)
 {
 	int i;
+#ifdef XRANDR
+	int major, minor;
+#endif /* XRANDR */
 	pid_t pid;
 	XSetWindowAttributes wa;
 	Atom utf8string;
@@ -2142,6 +2931,14 @@ setup(void)
 		die("no fonts could be loaded.");
 	lrpad = drw->fonts->h;
 	bh = drw->fonts->h + 2;
+#ifdef XRANDR
+	/* monitors by name need RandR 1.5 */
+	if (XRRQueryExtension(dpy, &rrevbase, &i) && XRRQueryVersion(dpy, &major, &minor)
+	&& (major > 1 || minor >= 5))
+		XRRSelectInput(dpy, root, RRScreenChangeNotifyMask|RRCrtcChangeNotifyMask|RROutputChangeNotifyMask);
+	else
+		rrevbase = -1;
+#endif /* XRANDR */
 	updategeom();
 	/* init atoms */
 	utf8string = XInternAtom(dpy, "UTF8_STRING", False);
@@ -2162,10 +2959,25 @@ setup(void)
 	netatom[NetWMWindowType] = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE", False);
 	netatom[NetWMWindowTypeDialog] = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DIALOG", False);
 	netatom[NetClientList] = XInternAtom(dpy, "_NET_CLIENT_LIST", False);
+	netatom[NetClientListStacking] = XInternAtom(dpy, "_NET_CLIENT_LIST_STACKING", False);
 	netatom[NetClientInfo] = XInternAtom(dpy, "_NET_CLIENT_INFO", False);
 	xatom[Manager] = XInternAtom(dpy, "MANAGER", False);
 	xatom[Xembed] = XInternAtom(dpy, "_XEMBED", False);
 	xatom[XembedInfo] = XInternAtom(dpy, "_XEMBED_INFO", False);
+#ifdef XCB
+	/* the property requests of manage(), see getprop() */
+	xcon = XGetXCBConnection(dpy);
+	pfspec[PropNetName]     = (PropSpec){ netatom[NetWMName], AnyPropertyType, TEXTLEN };
+	pfspec[PropName]        = (PropSpec){ XA_WM_NAME, AnyPropertyType, TEXTLEN };
+	pfspec[PropTrans]       = (PropSpec){ XA_WM_TRANSIENT_FOR, XA_WINDOW, 1L };
+	pfspec[PropClass]       = (PropSpec){ XA_WM_CLASS, XA_STRING, TEXTLEN };
+	pfspec[PropState]       = (PropSpec){ netatom[NetWMState], XA_ATOM, sizeof(Atom) };
+	pfspec[PropType]        = (PropSpec){ netatom[NetWMWindowType], XA_ATOM, sizeof(Atom) };
+	pfspec[PropNormalHints] = (PropSpec){ XA_WM_NORMAL_HINTS, XA_WM_SIZE_HINTS, 18L };
+	pfspec[PropHints]       = (PropSpec){ XA_WM_HINTS, XA_WM_HINTS, 9L };
+	pfspec[PropClientInfo]  = (PropSpec){ netatom[NetClientInfo], XA_CARDINAL, 2L };
+	pfspec[PropWMState]     = (PropSpec){ wmatom[WMState], wmatom[WMState], 2L };
+#endif /* XCB */
     /* init cursors */
 	cursor[CurNormal] = drw_cur_create(drw, XC_left_ptr);
 	cursor[CurResize] = drw_cur_create(drw, XC_sizing);
@@ -2175,8 +2987,23 @@ setup(void)
 	scheme[LENGTH(colors)] = drw_scm_create(drw, colors[0], 3);
 	for (i = 0; i < LENGTH(colors); i++)
 		scheme[i] = drw_scm_create(drw, colors[i], 3);
+	/* index rules */
+	for (i = 0; i < LENGTH(rules); i++) {
+		if (rules[i].title) {
+			rulepats[i][0] = pattern(rules[i].title);
+			rulehas[0] = 1;
+		}
+		if (rules[i].class) {
+			rulepats[i][1] = pattern(rules[i].class);
+			rulehas[1] = 1;
+		}
+		if (rules[i].instance) {
+			rulepats[i][2] = pattern(rules[i].instance);
+			rulehas[2] = 1;
+		}
+	}
 	/* init system tray */
-	updatesystray();
+	updatesystray(1);
 	/* init bars */
 	updatebars();
 	updatestatus();
@@ -2192,6 +3019,7 @@ setup(void)
 	XChangeProperty(dpy, root, netatom[NetSupported], XA_ATOM, 32,
 		PropModeReplace, (unsigned char *) netatom, NetLast);
 	XDeleteProperty(dpy, root, netatom[NetClientList]);
+	XDeleteProperty(dpy, root, netatom[NetClientListStacking]);
 	XDeleteProperty(dpy, root, netatom[NetClientInfo]);
 	/* select events */
 	wa.cursor = cursor[CurNormal]->cursor;
@@ -2209,7 +3037,7 @@ seturgent(Client *c, int urg)
 {
 	XWMHints *wmh;
 
-	c->isurgent = urg;
+	settags(c, c->tags, urg);
 	if (!(wmh = XGetWMHints(dpy, c->win)))
 		return;
 	wmh->flags = urg ? (wmh->flags | XUrgencyHint) : (wmh->flags & ~XUrgencyHint);
@@ -2275,12 +3103,22 @@ spawn(const Arg *arg)
 	}
 }
 
+#ifdef SPTIME
+/* print how long scratchpad i took to show up since togglescratch() at t */
+void
+sptime(unsigned int i, uintmax_t t, const char *how)
+{
+	XSync(dpy, False);
+	fprintf(stderr, "dwm: %s shown in %.3f ms, %s\n", scratchpads[i].name,
+	        (usnow() - t) / 1000.0, how);
+}
+#endif /* SPTIME */
+
+/* written by flushprops(), however often the tags change meanwhile */
 void
 setclienttagprop(Client *c)
 {
-	long data[] = { (long) c->tags, (long) c->mon->num };
-	XChangeProperty(dpy, c->win, netatom[NetClientInfo], XA_CARDINAL, 32,
-			PropModeReplace, (unsigned char *) data, 2);
+	c->infodirty = infodirty = 1;
 }
 
 void
@@ -2289,7 +3127,7 @@ tag(const Arg *arg)
 	Client *c;
 	if (selmon->sel && arg->ui & TAGMASK) {
 		c = selmon->sel;
-		selmon->sel->tags = arg->ui & TAGMASK;
+		settags(c, arg->ui & TAGMASK, c->isurgent);
 		setclienttagprop(c);
 		focus(NULL);
 		arrange(selmon);
@@ -2357,11 +3195,26 @@ void
 togglescratch(const Arg *arg)
 {
 	Client *c;
+	Monitor *m;
 	unsigned int found = 0;
 	unsigned int scratchtag = SPTAG(arg->ui);
 	Arg sparg = {.v = scratchpads[arg->ui].cmd};
+#ifdef SPTIME
+	uintmax_t t = usnow();
+#endif /* SPTIME */
 
 	for (c = selmon->clients; c && !(found = c->tags & scratchtag); c = c->next);
+	/* a hidden one on another monitor, such as a prewarmed one, comes here */
+	for (m = mons; m && !found; m = m->next)
+		for (c = m->clients; c && !(found = c->tags & scratchtag && !ISVISIBLE(c)); c = c->next);
+	if (found && c->mon != selmon) {
+		detach(c);
+		detachstack(c);
+		c->mon = selmon;
+		attachbottom(c);
+		attachstack(c);
+		setclienttagprop(c);
+	}
 	if (found) {
 		unsigned int newtagset = selmon->tagset[selmon->seltags] ^ scratchtag;
 		if (newtagset) {
@@ -2372,10 +3225,21 @@ togglescratch(const Arg *arg)
 		if (ISVISIBLE(c)) {
 			focus(c);
 			restack(selmon);
+#ifdef SPTIME
+			sptime(arg->ui, t, "running");
+#endif /* SPTIME */
 		}
 	} else {
 		selmon->tagset[selmon->seltags] |= scratchtag;
-		spawn(&sparg);
+		/* a prewarmed one on its way shows up by itself, unless it
+		 * never comes, then the next toggle starts one */
+		if (spwarming & scratchtag)
+			spwarming &= ~scratchtag;
+		else
+			spawn(&sparg);
+#ifdef SPTIME
+		sptoggled[arg->ui] = t;
+#endif /* SPTIME */
 	}
 }
 
@@ -2388,7 +3252,7 @@ toggletag(const Arg *arg)
 		return;
 	newtags = selmon->sel->tags ^ (arg->ui & TAGMASK);
 	if (newtags) {
-		selmon->sel->tags = newtags;
+		settags(selmon->sel, newtags, selmon->sel->isurgent);
 		setclienttagprop(selmon->sel);
 		focus(NULL);
 		arrange(selmon);
@@ -2449,6 +3313,7 @@ unmanage(Client *c, int destroyed)
 {
 	Monitor *m = c->mon;
 	XWindowChanges wc;
+	unsigned int i, ctags = c->tags;
 
 	detach(c);
 	detachstack(c);
@@ -2468,6 +3333,10 @@ unmanage(Client *c, int destroyed)
 	focus(NULL);
 	updateclientlist();
 	arrange(m);
+	/* have the next one ready */
+	for (i = 0; running && i < LENGTH(scratchpads); i++)
+		if (scratchpads[i].prewarm && ctags & SPTAG(i))
+			prewarm(i);
 }
 
 void
@@ -2486,8 +3355,35 @@ unmapnotify(XEvent *e)
 		/* KLUDGE! sometimes icons occasionally unmap their windows, but do
 		 * _not_ destroy them. We map those windows back */
 		XMapRaised(dpy, c->win);
-		updatesystray();
+		updatesystray(1);
+	}
+}
+
+void
+unprefetch(void)
+{
+#ifdef XCB
+	unsigned int i;
+	int j;
+
+	for (i = 0; i < npf; i++) {
+		if (pf[i].got & 1 << PropLast) {
+			free(pf[i].attrs);
+			free(pf[i].geom);
+		} else {
+			xcb_discard_reply(xcon, pf[i].attrc.sequence);
+			xcb_discard_reply(xcon, pf[i].geomc.sequence);
+		}
+		for (j = 0; j < PropLast; j++)
+			if (pf[i].got & 1 << j)
+				free(pf[i].props[j]);
+			else
+				xcb_discard_reply(xcon, pf[i].propc[j].sequence);
 	}
+	free(pf);
+	pf = NULL;
+	npf = 0;
+#endif /* XCB */
 }
 
 void
@@ -2531,29 +3427,124 @@ updatebarpos(Monitor *m)
 		m->by = -bh;
 }
 
+/* written by flushprops() */
 void
 updateclientlist()
 {
-	Client *c;
-	Monitor *m;
+	clientsdirty = 1;
+}
 
-	XDeleteProperty(dpy, root, netatom[NetClientList]);
-	for (m = mons; m; m = m->next)
-		for (c = m->clients; c; c = c->next)
-			XChangeProperty(dpy, root, netatom[NetClientList],
-				XA_WINDOW, 32, PropModeAppend,
-				(unsigned char *) &(c->win), 1);
+#ifdef XRANDR
+/* refresh rate of the first output of a monitor, in Hz */
+static int
+refreshrate(XRRScreenResources *res, XRRMonitorInfo *info)
+{
+	int i, rate = 60;
+	XRROutputInfo *out;
+	XRRCrtcInfo *crtc;
+
+	if (!res || info->noutput < 1
+	|| !(out = XRRGetOutputInfo(dpy, res, info->outputs[0])))
+		return rate;
+	if (out->crtc && (crtc = XRRGetCrtcInfo(dpy, res, out->crtc))) {
+		for (i = 0; i < res->nmode; i++)
+			if (res->modes[i].id == crtc->mode
+			&& res->modes[i].hTotal && res->modes[i].vTotal)
+				rate = MAX(1, (int)(res->modes[i].dotClock
+					/ ((double)res->modes[i].hTotal * res->modes[i].vTotal) + 0.5));
+		XRRFreeCrtcInfo(crtc);
+	}
+	XRRFreeOutputInfo(out);
+	return rate;
 }
 
+/* RandR names its monitors: keep the ones still there, wherever they moved
+ * in the list, touch only those that changed and hand the clients of the
+ * unplugged ones to the first monitor */
+static int
+updaterandr(XRRMonitorInfo *info, int n)
+{
+	int i, j, num, dirty = 0;
+	Monitor *m, *old = mons, **pm, **tail;
+	XRRMonitorInfo t;
+	XRRScreenResources *res = XRRGetScreenResourcesCurrent(dpy, root);
+
+	/* the primary monitor first, as with Xinerama */
+	for (i = 1; i < n && !info[i].primary; i++);
+	if (i < n) {
+		t = info[i];
+		memmove(&info[1], &info[0], i * sizeof(XRRMonitorInfo));
+		info[0] = t;
+	}
+	mons = NULL;
+	for (i = num = 0, tail = &mons; i < n; i++) {
+		/* only consider unique geometries as separate screens */
+		for (j = 0; j < i; j++)
+			if (info[j].x == info[i].x && info[j].y == info[i].y
+			&& info[j].width == info[i].width && info[j].height == info[i].height)
+				break;
+		if (j < i)
+			continue;
+		for (pm = &old; *pm && (*pm)->rrname != info[i].name; pm = &(*pm)->next);
+		if ((m = *pm)) {
+			*pm = m->next;
+		} else {
+			m = createmon();
+			m->rrname = info[i].name;
+			m->num = -1;
+		}
+		m->next = NULL;
+		*tail = m;
+		tail = &m->next;
+		dirty |= placemon(m, num++, info[i].x, info[i].y, info[i].width, info[i].height);
+		m->rate = refreshrate(res, &info[i]);
+	}
+	/* none at all, e.g. with every output off: the whole screen is kept as
+	 * the first monitor of before, which finds its state again by name */
+	if (!mons) {
+		if ((m = old))
+			old = m->next;
+		else
+			m = createmon();
+		m->next = NULL;
+		mons = m;
+		tail = &m->next;
+		dirty |= placemon(m, 0, 0, 0, sw, sh);
+	}
+	/* whatever is left was unplugged */
+	*tail = old;
+	while ((m = old)) {
+		old = m->next;
+		dirty = 1;
+		adoptclients(mons, m);
+		if (m == selmon)
+			selmon = mons;
+		cleanupmon(m);
+	}
+	if (res)
+		XRRFreeScreenResources(res);
+	return dirty;
+}
+#endif /* XRANDR */
+
 int
 updategeom(void)
 {
 	int dirty = 0;
-
+#ifdef XRANDR
+	int n = 0;
+	XRRMonitorInfo *info = NULL;
+
+	/* monitors are matched by name as long as RandR is there, even when
+	 * it reports none for a moment */
+	if (rrevbase >= 0) {
+		info = XRRGetMonitors(dpy, root, True, &n);
+		dirty = updaterandr(info, info ? n : 0);
+	} else
+#endif /* XRANDR */
 #ifdef XINERAMA
 	if (XineramaIsActive(dpy)) {
 		int i, j, n, nn;
-		Client *c;
 		Monitor *m;
 		XineramaScreenInfo *info = XineramaQueryScreens(dpy, &nn);
 		XineramaScreenInfo *unique = NULL;
@@ -2576,28 +3567,14 @@ updategeom(void)
 				mons = createmon();
 		}
 		for (i = 0, m = mons; i < nn && m; m = m->next, i++)
-			if (i >= n
-			|| unique[i].x_org != m->mx || unique[i].y_org != m->my
-			|| unique[i].width != m->mw || unique[i].height != m->mh)
-			{
-				dirty = 1;
-				m->num = i;
-				m->mx = m->wx = unique[i].x_org;
-				m->my = m->wy = unique[i].y_org;
-				m->mw = m->ww = unique[i].width;
-				m->mh = m->wh = unique[i].height;
-				updatebarpos(m);
-			}
+			dirty |= placemon(m, i, unique[i].x_org, unique[i].y_org,
+			                  unique[i].width, unique[i].height);
 		/* removed monitors if n > nn */
 		for (i = nn; i < n; i++) {
 			for (m = mons; m && m->next; m = m->next);
-			while ((c = m->clients)) {
+			if (m->clients) {
 				dirty = 1;
-				m->clients = c->next;
-				detachstack(c);
-				c->mon = mons;
-				attachbottom(c);
-				attachstack(c);
+				adoptclients(mons, m);
 			}
 			if (m == selmon)
 				selmon = mons;
@@ -2609,13 +3586,12 @@ updategeom(void)
 	{ /* default monitor setup */
 		if (!mons)
 			mons = createmon();
-		if (mons->mw != sw || mons->mh != sh) {
-			dirty = 1;
-			mons->mw = mons->ww = sw;
-			mons->mh = mons->wh = sh;
-			updatebarpos(mons);
-		}
+		dirty = placemon(mons, 0, 0, 0, sw, sh);
 	}
+#ifdef XRANDR
+	if (info)
+		XRRFreeMonitors(info);
+#endif /* XRANDR */
 	if (dirty) {
 		selmon = mons;
 		selmon = wintomon(root);
@@ -2639,13 +3615,45 @@ updatenumlockmask(void)
 	XFreeModifiermap(modmap);
 }
 
+/* the root window was resized or monitors came, went or changed, which
+ * comes in bursts when docking: catch up once per event batch */
+void
+updatescreen(void)
+{
+	Client *c;
+	Monitor *m, *sel = selmon;
+	int resized = geompending == 2;
+
+	if (!geompending)
+		return;
+	geompending = 0;
+	if (!updategeom() && !resized)
+		return;
+	if (resized)
+		drw_resize(drw, sw, bh);
+	updatebars();
+	/* only what updategeom() changed, the rest stays as it is */
+	for (m = mons; m; m = m->next) {
+		if (!m->changed)
+			continue;
+		for (c = m->clients; c; c = c->next)
+			if (c->isfullscreen)
+				resizeclient(c, m->mx, m->my, m->mw, m->mh);
+		resizebarwin(m);
+		arrange(m);
+	}
+	if (selmon != sel || selmon->changed)
+		focus(NULL);
+	for (m = mons; m; m = m->next)
+		m->changed = 0;
+}
+
 void
 updatesizehints(Client *c)
 {
-	long msize;
 	XSizeHints size;
 
-	if (!XGetWMNormalHints(dpy, c->win, &size, &msize))
+	if (!getsizehints(c->win, &size))
 		/* size is uninitialized, ensure that size.flags aren't used */
 		size.flags = PSize;
 	if (size.flags & PBaseSize) {
@@ -2686,10 +3694,16 @@ updatesizehints(Client *c)
 void
 updatestatus(void)
 {
-	if (!gettextprop(root, XA_WM_NAME, stext, sizeof(stext)))
-		strcpy(stext, "dwm-"VERSION);
+	char text[sizeof stext];
+
+	if (!gettextprop(root, XA_WM_NAME, text, sizeof(text)))
+		strcpy(text, "dwm-"VERSION);
+	/* nothing to redraw if the status did not change */
+	if (!strcmp(text, stext))
+		return;
+	memcpy(stext, text, sizeof(stext));
 	drawbar(selmon);
-	updatesystray();
+	updatesystray(0);
 }
 
 
@@ -2744,21 +3758,27 @@ updatesystrayiconstate(Client *i, XPropertyEvent *ev)
 			systray->win, XEMBED_EMBEDDED_VERSION);
 }
 
+/* lay out the tray and its icons, unless it would end up where it is and
+ * nothing was added, removed or resized (force) */
 void
-updatesystray(void)
+updatesystray(int force)
 {
+	static Monitor *lastm;
+	static unsigned int lastx;
+	static int lasty;
 	XSetWindowAttributes wa;
 	XWindowChanges wc;
 	Client *i;
 	Monitor *m = systraytomon(NULL);
 	unsigned int x = m->mx + m->mw;
-	unsigned int sw = TEXTW(stext) - lrpad + systrayspacing;
 	unsigned int w = 1;
 
 	if (!showsystray)
 		return;
 	if (systrayonleft)
-		x -= sw + lrpad / 2;
+		x -= TEXTW(stext) - lrpad + systrayspacing + lrpad / 2;
+	if (systray && !force && m == lastm && x == lastx && m->by == lasty)
+		return;
 	if (!systray) {
 		/* init systray */
 		if (!(systray = (Systray *)calloc(1, sizeof(Systray))))
@@ -2784,6 +3804,9 @@ updatesystray(void)
 			return;
 		}
 	}
+	lastm = m;
+	lastx = x;
+	lasty = m->by;
 	for (w = 0, i = systray->icons; i; i = i->next) {
 		/* make sure the background color stays the same */
 		wa.background_pixel  = scheme[SchemeNorm][ColBg].pixel;
@@ -2834,22 +3857,30 @@ updatewindowtype(Client *c)
 void
 updatewmhints(Client *c)
 {
-	XWMHints *wmh;
+	XWMHints wmh;
 
-	if ((wmh = XGetWMHints(dpy, c->win))) {
-		if (c == selmon->sel && wmh->flags & XUrgencyHint) {
-			wmh->flags &= ~XUrgencyHint;
-			XSetWMHints(dpy, c->win, wmh);
+	if (getwmhints(c->win, &wmh)) {
+		if (c == selmon->sel && wmh.flags & XUrgencyHint) {
+			wmh.flags &= ~XUrgencyHint;
+			XSetWMHints(dpy, c->win, &wmh);
 		} else
-			c->isurgent = (wmh->flags & XUrgencyHint) ? 1 : 0;
-		if (wmh->flags & InputHint)
-			c->neverfocus = !wmh->input;
+			settags(c, c->tags, (wmh.flags & XUrgencyHint) ? 1 : 0);
+		if (wmh.flags & InputHint)
+			c->neverfocus = !wmh.input;
 		else
 			c->neverfocus = 0;
-		XFree(wmh);
 	}
 }
 
+uintmax_t
+usnow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
 void
 view(const Arg *arg)
 {
@@ -2910,6 +3941,42 @@ viewtoright(const Arg *arg) {
 	}
 }
 
+/* the 'c' line of c on monitor mon, see readclient() */
+void
+writeclient(FILE *fp, Client *c, int mon)
+{
+	fprintf(fp, "c %lu %d %u %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d\n",
+		c->win, mon, c->tags, c->x, c->y, c->w, c->h, c->oldx,
+		c->oldy, c->oldw, c->oldh, c->bw, c->oldbw, c->isfloating,
+		c->isfullscreen, c->oldstate, c->alwaysontop, c->isurgent);
+}
+
+/* m with its pertag state, clients and stack, see readmon() and
+ * readpertag() */
+void
+writemon(FILE *fp, Monitor *m)
+{
+	int i;
+	Client *c;
+
+	fprintf(fp, "m %d %u %u %u %u %d %d %f %d %d %d %d %d %d %d %c %u %u\n",
+		m->num, m->seltags, m->tagset[0], m->tagset[1], m->sellt,
+		(int)(m->lt[0] - layouts), (int)(m->lt[1] - layouts), m->mfact,
+		m->nmaster, m->showbar, m->topbar, m->gappih, m->gappiv,
+		m->gappoh, m->gappov, m->wfsymbol[0], m->pertag->curtag,
+		m->pertag->prevtag);
+	for (i = 0; i <= (int)LENGTH(tags); i++)
+		fprintf(fp, "p %d %d %f %u %d %d %d\n", i, m->pertag->nmasters[i],
+			m->pertag->mfacts[i], m->pertag->sellts[i],
+			(int)(m->pertag->ltidxs[i][0] - layouts),
+			(int)(m->pertag->ltidxs[i][1] - layouts),
+			m->pertag->showbars[i]);
+	for (c = m->clients; c; c = c->next)
+		writeclient(fp, c, m->num);
+	for (c = m->stack; c; c = c->snext)
+		fprintf(fp, "s %lu\n", c->win);
+}
+
 Client *
 wintoclient(Window w)
 {
@@ -3017,10 +4084,21 @@ zoom(const Arg *arg)
 int
 main(int argc, char *argv[])
 {
+	unsigned int i;
+	char *env;
+
 	if (argc == 2 && !strcmp("-v", argv[1]))
 		die("dwm-"VERSION);
 	else if (argc != 1)
 		die("usage: dwm [-v]");
+	/* the state of an in-place restart, kept from autostart and spawn() */
+	if ((env = getenv("DWM_STATE"))) {
+		if ((statefd = atoi(env)) > STDERR_FILENO)
+			fcntl(statefd, F_SETFD, FD_CLOEXEC);
+		else
+			statefd = -1;
+		unsetenv("DWM_STATE");
+	}
 	if (!setlocale(LC_CTYPE, "") || !XSupportsLocale())
 		fputs("warning: no locale support\n", stderr);
 	if (!(dpy = XOpenDisplay(NULL)))
@@ -3033,8 +4111,15 @@ main(int argc, char *argv[])
 		die("pledge");
 #endif /* __OpenBSD__ */
 	scan();
+	for (i = 0; i < LENGTH(scratchpads); i++)
+		if (scratchpads[i].prewarm)
+			prewarm(i);
 	run();
-	if(restart) execvp(argv[0], argv);
+	if (restart) {
+		savestate();
+		XSync(dpy, False);
+		execvp(argv[0], argv);
+	}
 	cleanup();
 	XCloseDisplay(dpy);
 	return EXIT_SUCCESS;
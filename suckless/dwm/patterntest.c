@@ -0,0 +1,149 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * checks contains() against strstr() on random strings and on the kind of
+ * classes, instances and titles rules[] are matched with, see `make test'.
+ * With -b, also prints what matching them costs per window.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "util.h"
+
+#define LENGTH(X)               (sizeof X / sizeof X[0])
+
+/* WM_CLASS and WM_NAME of some common windows */
+static const char *windows[] = {
+	"st-256color", "st", "~/src/dwm: vim dwm.c",
+	"Alacritty", "Alacritty", "user@host: ~",
+	"Navigator", "firefox",
+	"dwm-setup/dwm.c at master · abuabdelrahman1413/dwm-setup — Mozilla Firefox",
+	"Picture-in-Picture",
+	"thunar", "Thunar", "Home - Thunar",
+	"gl", "mpv", "Some.Video.2023.1080p.WEB-DL.x264.mkv - mpv",
+	"lxappearance", "Lxappearance", "Customize Look and Feel",
+	"spterm", "st-256color", "st",
+	"gimp", "Gimp-2.10", "GNU Image Manipulation Program",
+	"steam", "Steam", "Friends List",
+	"discord", "discord", "#general | Some Server - Discord",
+	"pavucontrol", "Pavucontrol", "Volume Control",
+	"org.pwmt.zathura", "Zathura", "The C Programming Language.pdf [1/288]",
+	"pinentry-gtk-2", "Pinentry-gtk-2", "Pinentry",
+	"keepassxc", "KeePassXC", "Passwords.kdbx [Locked] - KeePassXC",
+	"emacs", "Emacs", "*scratch* - GNU Emacs at host",
+	"spotify", "Spotify", "Spotify Premium",
+	"zoom", "zoom", "Zoom Meeting",
+	"obs", "obs", "OBS 29.1.3 - Profile: Untitled - Scenes: Untitled",
+	"xev", "Event Tester", "Event Tester",
+};
+
+/* classes, instances and titles found in rules[] */
+static const char *rules[] = {
+	"Thunar", "mpv", "Lxappearance", "spterm",
+	"Gimp", "Firefox", "firefox", "Steam", "discord", "Pavucontrol",
+	"zoom", "Picture-in-Picture", "Event Tester", "Pinentry",
+	"KeePassXC", "Zathura", "Spotify", "obs", "Emacs", "Sxiv",
+	"Yad", "Galculator", "Blueman-manager", "Arandr", "floating",
+};
+
+static int fails;
+
+static void
+check(const char *s, const char *p)
+{
+	Pattern sp = pattern(s), pp = pattern(p);
+
+	if (contains(s, &sp, p, &pp) != (strstr(s, p) != NULL)) {
+		fprintf(stderr, "patterntest: '%s' in '%s' is wrong\n", p, s);
+		fails++;
+	}
+}
+
+/* up to max - 1 characters of a small alphabet, so that there are hits */
+static void
+randstr(char *s, size_t max)
+{
+	static const char abc[] = "abcdefgh-. A";
+	size_t i, n;
+
+	n = rand() % max;
+	for (i = 0; i < n; i++)
+		s[i] = abc[rand() % (sizeof(abc) - 1)];
+	s[n] = '\0';
+}
+
+static double
+nsnow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* every window against every rule, as applyrules() would, with and
+ * without the patterns */
+static void
+bench(void)
+{
+	static Pattern rp[LENGTH(rules)];
+	Pattern wp;
+	size_t i, j, r, reps = 20000, calls = 0, hits = 0;
+	volatile size_t sink = 0;
+	double t;
+
+	for (j = 0; j < LENGTH(rules); j++)
+		rp[j] = pattern(rules[j]);
+	/* with empty strings contains() tells whether the patterns let the
+	 * strstr() through */
+	for (i = 0; i < LENGTH(windows); i++) {
+		wp = pattern(windows[i]);
+		for (j = 0; j < LENGTH(rules); j++) {
+			calls += contains("", &wp, "", &rp[j]);
+			hits += strstr(windows[i], rules[j]) != NULL;
+		}
+	}
+
+	t = nsnow();
+	for (r = 0; r < reps; r++)
+		for (i = 0; i < LENGTH(windows); i++) {
+			wp = pattern(windows[i]);
+			for (j = 0; j < LENGTH(rules); j++)
+				sink += contains(windows[i], &wp, rules[j], &rp[j]);
+		}
+	printf("%zu rules: %.0f ns per string with contains(), ",
+	       LENGTH(rules), (nsnow() - t) / reps / LENGTH(windows));
+	t = nsnow();
+	for (r = 0; r < reps; r++)
+		for (i = 0; i < LENGTH(windows); i++)
+			for (j = 0; j < LENGTH(rules); j++)
+				sink += strstr(windows[i], rules[j]) != NULL;
+	printf("%.0f ns with strstr()\n", (nsnow() - t) / reps / LENGTH(windows));
+	printf("%zu of %zu strstr() calls left, %zu matches\n",
+	       calls, LENGTH(windows) * LENGTH(rules), hits);
+}
+
+int
+main(int argc, char *argv[])
+{
+	char s[256], p[8];
+	size_t i, j;
+
+	srand(1);
+	for (i = 0; i < 200000; i++) {
+		randstr(s, sizeof(s));
+		randstr(p, sizeof(p));
+		check(s, p);
+	}
+	for (i = 0; i < LENGTH(windows); i++) {
+		for (j = 0; j < LENGTH(rules); j++)
+			check(windows[i], rules[j]);
+		for (j = 0; j < LENGTH(windows); j++)
+			check(windows[i], windows[j]);
+	}
+	if (argc > 1 && !strcmp(argv[1], "-b"))
+		bench();
+
+	return fails != 0;
+}
@@ -0,0 +1,164 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * docks and undocks a laptop the way RandR reports it to updaterandr(),
+ * see `make test'. Needs no X server: the few requests it makes are
+ * answered below.
+ */
+#define main dwmmain
+#include "dwm.c"
+#undef main
+
+#define CHECK(X) if (!(X)) { fprintf(stderr, "rrtest: %s\n", #X); fails++; }
+
+static int fails;
+
+#ifdef XRANDR
+enum { EDP = 1, HDMI }; /* output, crtc and mode of each */
+
+/* 1920x1080 at 60 Hz and 2560x1440 at 144 Hz */
+static XRRModeInfo modes[] = {
+	{ .id = EDP, .dotClock = 148500000, .hTotal = 2200, .vTotal = 1125 },
+	{ .id = HDMI, .dotClock = 587520000, .hTotal = 2720, .vTotal = 1500 },
+};
+static XRRScreenResources res = { .nmode = LENGTH(modes), .modes = modes };
+static XRROutputInfo outs[LENGTH(modes) + 1];
+static XRRCrtcInfo crtcs[LENGTH(modes) + 1];
+static RROutput edp = EDP, hdmi = HDMI;
+
+XRRScreenResources *
+XRRGetScreenResourcesCurrent(Display *d, Window w)
+{
+	return &res;
+}
+
+void
+XRRFreeScreenResources(XRRScreenResources *r)
+{
+}
+
+XRROutputInfo *
+XRRGetOutputInfo(Display *d, XRRScreenResources *r, RROutput o)
+{
+	outs[o].crtc = o;
+	return &outs[o];
+}
+
+void
+XRRFreeOutputInfo(XRROutputInfo *o)
+{
+}
+
+XRRCrtcInfo *
+XRRGetCrtcInfo(Display *d, XRRScreenResources *r, RRCrtc c)
+{
+	crtcs[c].mode = c;
+	return &crtcs[c];
+}
+
+void
+XRRFreeCrtcInfo(XRRCrtcInfo *c)
+{
+}
+
+/* cleanupmon() of unplugged monitors, which have no bar here */
+int
+XUnmapWindow(Display *d, Window w)
+{
+	return 1;
+}
+
+int
+XDestroyWindow(Display *d, Window w)
+{
+	return 1;
+}
+
+static void
+clearchanged(void)
+{
+	Monitor *m;
+
+	for (m = mons; m; m = m->next)
+		m->changed = 0;
+}
+
+int
+main(void)
+{
+	XRRMonitorInfo laptop[] = {
+		{ .name = EDP, .primary = 1, .noutput = 1, .outputs = &edp,
+		  .width = 1920, .height = 1080 },
+	}, docked[] = {
+		{ .name = EDP, .noutput = 1, .outputs = &edp,
+		  .width = 1920, .height = 1080 },
+		{ .name = HDMI, .primary = 1, .noutput = 1, .outputs = &hdmi,
+		  .x = 1920, .width = 2560, .height = 1440 },
+		/* a mirror of the laptop is no monitor of its own */
+		{ .name = HDMI + 1, .width = 1920, .height = 1080 },
+	}, info[LENGTH(docked)];
+	Client c = { 0 };
+	Monitor *lm, *em;
+
+	sw = 1920;
+	sh = 1080;
+
+	/* the laptop alone, as setup() finds it */
+	memcpy(info, laptop, sizeof laptop);
+	CHECK(updaterandr(info, LENGTH(laptop)));
+	selmon = lm = mons;
+	CHECK(lm && !lm->next && lm->num == 0 && lm->rrname == EDP);
+	CHECK(lm->mw == 1920 && lm->mh == 1080 && lm->rate == 60 && lm->changed);
+	lm->pertag->curtag = 3;
+	lm->mfact = 0.25;
+	c.tags = 1;
+	c.mon = lm;
+	lm->clients = lm->stack = &c;
+	account(&c, 1);
+	clearchanged();
+	memcpy(info, laptop, sizeof laptop);
+	CHECK(!updaterandr(info, LENGTH(laptop)) && !lm->changed);
+
+	/* docked: the external one is primary, so it comes first */
+	memcpy(info, docked, sizeof docked);
+	c.infodirty = 0;
+	CHECK(updaterandr(info, LENGTH(docked)));
+	em = mons;
+	CHECK(em && em->rrname == HDMI && em->num == 0 && em->changed);
+	CHECK(em->mx == 1920 && em->mw == 2560 && em->rate == 144);
+	CHECK(em->next == lm && !lm->next && lm->num == 1 && lm->changed);
+	CHECK(lm->mw == 1920 && lm->rate == 60);
+	CHECK(lm->pertag->curtag == 3 && lm->mfact == 0.25);
+	CHECK(c.mon == lm && c.infodirty && selmon == lm);
+
+	/* the client goes to the external monitor, which is then unplugged */
+	account(&c, -1);
+	lm->clients = lm->stack = NULL;
+	c.mon = em;
+	em->clients = em->stack = &c;
+	account(&c, 1);
+	selmon = em;
+	clearchanged();
+	memcpy(info, laptop, sizeof laptop);
+	CHECK(updaterandr(info, LENGTH(laptop)));
+	CHECK(mons == lm && !lm->next && lm->num == 0 && lm->changed);
+	CHECK(lm->clients == &c && lm->stack == &c && c.mon == lm);
+	CHECK(lm->nclients[0] == 1 && lm->occ == 1);
+	CHECK(selmon == lm && lm->pertag->curtag == 3);
+
+	/* every output off for a moment, e.g. while the lid is closed */
+	clearchanged();
+	CHECK(!updaterandr(NULL, 0));
+	CHECK(mons == lm && !lm->next && lm->rrname == EDP && lm->mw == 1920);
+	memcpy(info, laptop, sizeof laptop);
+	CHECK(!updaterandr(info, LENGTH(laptop)) && mons == lm && !lm->changed);
+
+	return fails != 0;
+}
+#else
+int
+main(void)
+{
+	fprintf(stderr, "rrtest: built without XRANDR, see config.mk\n");
+	return fails != 0;
+}
+#endif /* XRANDR */
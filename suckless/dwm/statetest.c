@@ -0,0 +1,143 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * writes monitors and clients the way savestate() hands them down on an
+ * in-place restart and reads them back like restorestate(), see `make test'.
+ * Needs no X server: only the text format is tested.
+ */
+#define main dwmmain
+#include "dwm.c"
+#undef main
+
+#define CHECK(X) if (!(X)) { fprintf(stderr, "statetest: %s\n", #X); fails++; }
+
+static int fails;
+
+static Monitor *
+mkmons(void)
+{
+	Monitor *m;
+
+	m = createmon();
+	m->next = createmon();
+	m->next->num = 1;
+	return m;
+}
+
+int
+main(void)
+{
+	char line[256];
+	int mon, nc = 0, ns = 0;
+	unsigned int i;
+	Client c = { 0 }, r;
+	Monitor *om, *m, *o;
+	FILE *fp;
+
+	/* two monitors with nothing left at what createmon() sets */
+	om = mons = mkmons();
+	for (m = mons; m; m = m->next) {
+		m->seltags = 1;
+		m->tagset[0] = 1 << 2;
+		m->tagset[1] = 1 << 4 | 1;
+		m->sellt = 1;
+		m->lt[0] = &layouts[LENGTH(layouts) - 1];
+		m->lt[1] = &layouts[0];
+		m->mfact = 0.7;
+		m->nmaster = 3 + m->num;
+		m->showbar = m->topbar = 0;
+		m->gappih = 1;
+		m->gappiv = 2;
+		m->gappoh = 3;
+		m->gappov = 4;
+		m->wfsymbol[0] = WFINACTIVE;
+		m->pertag->curtag = 3;
+		m->pertag->prevtag = 5;
+		for (i = 0; i <= LENGTH(tags); i++) {
+			m->pertag->nmasters[i] = i;
+			m->pertag->mfacts[i] = 0.25 + i / 100.0;
+			m->pertag->sellts[i] = i & 1;
+			m->pertag->ltidxs[i][0] = &layouts[i % LENGTH(layouts)];
+			m->pertag->ltidxs[i][1] = &layouts[(i + 1) % LENGTH(layouts)];
+			m->pertag->showbars[i] = i & 1;
+		}
+	}
+	c.win = 0x1e00007;
+	c.tags = SPTAG(0) | 1;
+	c.x = -20; c.y = 30; c.w = 640; c.h = 480;
+	c.oldx = 1; c.oldy = 2; c.oldw = 3; c.oldh = 4;
+	c.bw = 1; c.oldbw = 2;
+	c.isfloating = c.isfullscreen = c.oldstate = c.alwaysontop = c.isurgent = 1;
+	c.mon = mons->next;
+	mons->next->clients = mons->next->stack = &c;
+	selmon = mons->next;
+
+	if (!(fp = tmpfile()))
+		die("tmpfile:");
+	for (m = mons; m; m = m->next)
+		writemon(fp, m);
+	fprintf(fp, "S %d\n", selmon->num);
+	rewind(fp);
+
+	/* read back into monitors as setup() makes them */
+	mons = mkmons();
+	m = NULL;
+	while (fgets(line, sizeof line, fp)) {
+		switch (line[0]) {
+		case 'm':
+			CHECK((m = readmon(line)));
+			break;
+		case 'p':
+			CHECK(m && readpertag(line, m));
+			break;
+		case 'c':
+			memset(&r, 0, sizeof r);
+			CHECK(readclient(line, &r, &mon));
+			CHECK(mon == 1);
+			CHECK(r.win == c.win && r.tags == c.tags);
+			CHECK(r.x == c.x && r.y == c.y && r.w == c.w && r.h == c.h);
+			CHECK(r.oldx == c.oldx && r.oldy == c.oldy);
+			CHECK(r.oldw == c.oldw && r.oldh == c.oldh);
+			CHECK(r.bw == c.bw && r.oldbw == c.oldbw);
+			CHECK(r.isfloating && r.isfullscreen && r.oldstate);
+			CHECK(r.alwaysontop && r.isurgent);
+			nc++;
+			break;
+		case 's':
+			CHECK(strtoul(line + 2, NULL, 10) == c.win);
+			ns++;
+			break;
+		case 'S':
+			CHECK(atoi(line + 2) == 1);
+			break;
+		default:
+			fprintf(stderr, "statetest: unknown line %s", line);
+			fails++;
+		}
+	}
+	CHECK(nc == 1 && ns == 1);
+	fclose(fp);
+
+	for (m = mons, o = om; m && o; m = m->next, o = o->next) {
+		CHECK(m->seltags == o->seltags && m->sellt == o->sellt);
+		CHECK(m->tagset[0] == o->tagset[0] && m->tagset[1] == o->tagset[1]);
+		CHECK(m->lt[0] == o->lt[0] && m->lt[1] == o->lt[1]);
+		CHECK(m->mfact == o->mfact && m->nmaster == o->nmaster);
+		CHECK(m->showbar == o->showbar && m->topbar == o->topbar);
+		CHECK(m->gappih == o->gappih && m->gappiv == o->gappiv);
+		CHECK(m->gappoh == o->gappoh && m->gappov == o->gappov);
+		CHECK(m->wfsymbol[0] == o->wfsymbol[0]);
+		CHECK(m->pertag->curtag == o->pertag->curtag);
+		CHECK(m->pertag->prevtag == o->pertag->prevtag);
+		for (i = 0; i <= LENGTH(tags); i++) {
+			CHECK(m->pertag->nmasters[i] == o->pertag->nmasters[i]);
+			CHECK(m->pertag->mfacts[i] == o->pertag->mfacts[i]);
+			CHECK(m->pertag->sellts[i] == o->pertag->sellts[i]);
+			CHECK(m->pertag->ltidxs[i][0] == o->pertag->ltidxs[i][0]);
+			CHECK(m->pertag->ltidxs[i][1] == o->pertag->ltidxs[i][1]);
+			CHECK(m->pertag->showbars[i] == o->pertag->showbars[i]);
+		}
+	}
+	CHECK(!m && !o);
+
+	return fails != 0;
+}
@@ -34,3 +34,35 @@ ecalloc(size_t nmemb, size_t size)
 		die("calloc:");
 	return p;
 }
+
+/* strstr(s, p), mostly answered by the patterns of both: p can only be in s
+ * if s is at least as long and has all of the bigrams of p */
+int
+contains(const char *s, const Pattern *sp, const char *p, const Pattern *pp)
+{
+	size_t i;
+
+	if (pp->len > sp->len)
+		return 0;
+	for (i = 0; i < sizeof(pp->bigrams) / sizeof(pp->bigrams[0]); i++)
+		if (pp->bigrams[i] & ~sp->bigrams[i])
+			return 0;
+	return strstr(s, p) != NULL;
+}
+
+/* the length of s and the set of its two-character sequences, hashed to
+ * one of 256 bits each: with 64, long window titles set nearly all of them */
+Pattern
+pattern(const char *s)
+{
+	Pattern p = { { 0 }, 0 };
+	unsigned int h;
+
+	for (; s[p.len]; p.len++) {
+		if (!s[p.len + 1])
+			continue;
+		h = ((unsigned char)s[p.len] * 31 + (unsigned char)s[p.len + 1]) % 256;
+		p.bigrams[h / 32] |= 1U << h % 32;
+	}
+	return p;
+}
@@ -6,3 +6,12 @@
 
 void die(const char *fmt, ...);
 void *ecalloc(size_t nmemb, size_t size);
+
+/* what contains() needs to know of a string, see pattern() */
+typedef struct {
+	unsigned int bigrams[8]; /* a set of 256 bits */
+	size_t len;
+} Pattern;
+
+int contains(const char *s, const Pattern *sp, const char *p, const Pattern *pp);
+Pattern pattern(const char *s);
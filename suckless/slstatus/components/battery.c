@@ -9,8 +9,11 @@
 /*
  * https://www.kernel.org/doc/html/latest/power/power_supply_class.html
  */
+	#include <errno.h>
 	#include <limits.h>
+	#include <linux/netlink.h>
 	#include <stdint.h>
+	#include <sys/socket.h>
 	#include <unistd.h>
 
 	#define POWER_SUPPLY_CAPACITY "/sys/class/power_supply/%s/capacity"
@@ -20,16 +23,75 @@
 	#define POWER_SUPPLY_CURRENT  "/sys/class/power_supply/%s/current_now"
 	#define POWER_SUPPLY_POWER    "/sys/class/power_supply/%s/power_now"
 
+	/*
+	 * Power supplies send a uevent when they are plugged, change state or
+	 * their charge changes noticeably, so listen to those instead of
+	 * relying on the interval alone.
+	 */
+	static void
+	watchuevents(void)
+	{
+		static int fd = -1;
+		struct sockaddr_nl sa = { .nl_family = AF_NETLINK, .nl_groups = 1 };
+		char msg[4096];
+		ssize_t n;
+
+		if (fd == -1) {
+			if ((fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK |
+			                 SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT)) < 0) {
+				warn("socket 'NETLINK_KOBJECT_UEVENT':");
+				fd = -2;
+			} else if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+				warn("bind 'NETLINK_KOBJECT_UEVENT':");
+				close(fd);
+				fd = -2;
+			}
+		}
+		if (fd < 0)
+			return;
+
+		while ((n = recv(fd, msg, sizeof(msg), 0)) > 0)
+			;
+		/* ENOBUFS only means uevents were lost, we read anyway */
+		if (n < 0 && errno != EAGAIN && errno != ENOBUFS) {
+			warn("recv 'NETLINK_KOBJECT_UEVENT':");
+			unwatchfd(fd);
+			close(fd);
+			fd = -1;
+			return;
+		}
+		watchfd(fd);
+	}
+
+	/* the status line, e.g. "Discharging" */
+	static int
+	status(const char *bat, char *state, size_t size)
+	{
+		char path[PATH_MAX];
+		const char *s;
+		size_t n;
+
+		if (esnprintf(path, sizeof(path), POWER_SUPPLY_STATUS, bat) < 0 ||
+		    !(s = kread(path)))
+			return -1;
+		if ((n = strcspn(s, "\n")) >= size)
+			n = size - 1;
+		memcpy(state, s, n);
+		state[n] = '\0';
+
+		return 0;
+	}
+
 	static const char *
 	pick(const char *bat, const char *f1, const char *f2, char *path,
 	     size_t length)
 	{
 		if (esnprintf(path, length, f1, bat) > 0 &&
-		    access(path, R_OK) == 0)
+		    access(syspath(path), R_OK) == 0)
 			return f1;
 
 		if (esnprintf(path, length, f2, bat) > 0 &&
-		    access(path, R_OK) == 0)
+		    access(syspath(path), R_OK) == 0)
 			return f2;
 
 		return NULL;
@@ -38,15 +100,16 @@
 	const char *
 	battery_perc(const char *bat)
 	{
-		int cap_perc;
+		uintmax_t cap_perc;
 		char path[PATH_MAX];
 
+		watchuevents();
 		if (esnprintf(path, sizeof(path), POWER_SUPPLY_CAPACITY, bat) < 0)
 			return NULL;
-		if (pscanf(path, "%d", &cap_perc) != 1)
+		if (kreadu(path, &cap_perc) < 0)
 			return NULL;
 
-		return bprintf("%d", cap_perc);
+		return bprintf("%ju", cap_perc);
 	}
 
 	const char *
@@ -62,11 +125,10 @@
 			{ "Not charging", "o" },
 		};
 		size_t i;
-		char path[PATH_MAX], state[12];
+		char state[16];
 
-		if (esnprintf(path, sizeof(path), POWER_SUPPLY_STATUS, bat) < 0)
-			return NULL;
-		if (pscanf(path, "%12[a-zA-Z ]", state) != 1)
+		watchuevents();
+		if (status(bat, state, sizeof(state)) < 0)
 			return NULL;
 
 		for (i = 0; i < LEN(map); i++)
@@ -81,22 +143,21 @@
 	{
 		uintmax_t charge_now, current_now, m, h;
 		double timeleft;
-		char path[PATH_MAX], state[12];
+		char path[PATH_MAX], state[16];
 
-		if (esnprintf(path, sizeof(path), POWER_SUPPLY_STATUS, bat) < 0)
-			return NULL;
-		if (pscanf(path, "%12[a-zA-Z ]", state) != 1)
+		watchuevents();
+		if (status(bat, state, sizeof(state)) < 0)
 			return NULL;
 
 		if (!pick(bat, POWER_SUPPLY_CHARGE, POWER_SUPPLY_ENERGY, path,
 		          sizeof(path)) ||
-		    pscanf(path, "%ju", &charge_now) < 0)
+		    kreadu(path, &charge_now) < 0)
 			return NULL;
 
 		if (!strcmp(state, "Discharging")) {
 			if (!pick(bat, POWER_SUPPLY_CURRENT, POWER_SUPPLY_POWER, path,
 			          sizeof(path)) ||
-			    pscanf(path, "%ju", &current_now) < 0)
+			    kreadu(path, &current_now) < 0)
 				return NULL;
 
 			if (current_now == 0)
@@ -1,6 +1,7 @@
 /* See LICENSE file for copyright and license details. */
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "../slstatus.h"
@@ -15,37 +16,40 @@
 		uintmax_t freq;
 
 		/* in kHz */
-		if (pscanf(CPU_FREQ, "%ju", &freq) != 1)
+		if (kreadu(CPU_FREQ, &freq) < 0)
 			return NULL;
 
 		return fmt_human(freq * 1000, 1000);
 	}
 
 	const char *
-	cpu_perc(const char *unused)
+	cpu_perc(const char *cpu)
 	{
-		static long double a[7];
-		long double b[7], sum;
-
-		memcpy(b, a, sizeof(b));
-		/* cpu user nice system idle iowait irq softirq */
-		if (pscanf("/proc/stat", "%*s %Lf %Lf %Lf %Lf %Lf %Lf %Lf",
-		           &a[0], &a[1], &a[2], &a[3], &a[4], &a[5], &a[6])
-		    != 7)
+		const struct procstat *p;
+		const uintmax_t *a;
+		uintmax_t *b, sum, busy;
+		size_t n;
+
+		/* NULL for all cores, else the core number */
+		n = cpu ? 1 + strtoul(cpu, NULL, 10) : 0;
+		if (!(p = procstat()) || n > p->ncpus)
 			return NULL;
-
+		a = p->cpu[n];
+		b = state(sizeof(p->cpu[n]));
+
+		/* user nice system idle iowait irq softirq */
+		sum = (a[0] + a[1] + a[2] + a[3] + a[4] + a[5] + a[6]) -
+		      (b[0] + b[1] + b[2] + b[3] + b[4] + b[5] + b[6]);
+		busy = (a[0] + a[1] + a[2] + a[5] + a[6]) -
+		       (b[0] + b[1] + b[2] + b[5] + b[6]);
 		if (b[0] == 0)
-			return NULL;
-
-		sum = (b[0] + b[1] + b[2] + b[3] + b[4] + b[5] + b[6]) -
-		      (a[0] + a[1] + a[2] + a[3] + a[4] + a[5] + a[6]);
+			sum = 0;
+		memcpy(b, a, sizeof(p->cpu[n]));
 
 		if (sum == 0)
 			return NULL;
 
-		return bprintf("%d", (int)(100 *
-		               ((b[0] + b[1] + b[2] + b[5] + b[6]) -
-		                (a[0] + a[1] + a[2] + a[5] + a[6])) / sum));
+		return bprintf("%d", (int)(100 * busy / sum));
 	}
 #elif defined(__OpenBSD__)
 	#include <sys/param.h>
@@ -76,17 +80,17 @@
 	cpu_perc(const char *unused)
 	{
 		int mib[2];
-		static uintmax_t a[CPUSTATES];
-		uintmax_t b[CPUSTATES], sum;
+		uintmax_t *a, b[CPUSTATES], sum;
 		size_t size;
 
 		mib[0] = CTL_KERN;
 		mib[1] = KERN_CPTIME;
 
-		size = sizeof(a);
+		a = state(sizeof(b));
+		size = sizeof(b);
 
 		memcpy(b, a, sizeof(b));
-		if (sysctl(mib, 2, &a, &size, NULL, 0) < 0) {
+		if (sysctl(mib, 2, a, &size, NULL, 0) < 0) {
 			warn("sysctl 'KERN_CPTIME':");
 			return NULL;
 		}
@@ -130,12 +134,12 @@
 	cpu_perc(const char *unused)
 	{
 		size_t size;
-		static long a[CPUSTATES];
-		long b[CPUSTATES], sum;
+		long *a, b[CPUSTATES], sum;
 
-		size = sizeof(a);
+		a = state(sizeof(b));
+		size = sizeof(b);
 		memcpy(b, a, sizeof(b));
-		if (sysctlbyname("kern.cp_time", &a, &size, NULL, 0) < 0 || !size) {
+		if (sysctlbyname("kern.cp_time", a, &size, NULL, 0) < 0 || !size) {
 			warn("sysctlbyname 'kern.cp_time':");
 			return NULL;
 		}
@@ -1,20 +1,71 @@
 /* See LICENSE file for copyright and license details. */
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 
 #include "../slstatus.h"
 #include "../util.h"
 
+/* the smallest unit of time fmt shows, in seconds */
+static int
+unit(const char *fmt)
+{
+	int u = 24 * 60 * 60;
+
+	for (; (fmt = strchr(fmt, '%')); fmt++) {
+		/* flags, field width and the E and O modifiers */
+		while (fmt[1] && strchr("_-0^#123456789EO", fmt[1]))
+			fmt++;
+		if (!*++fmt)
+			break;
+		if (strchr("STXcrs+", *fmt))
+			return 1;
+		if (strchr("MR", *fmt))
+			u = 60;
+		else if (strchr("HIklp", *fmt) && u > 60)
+			u = 60 * 60;
+	}
+
+	return u;
+}
+
 const char *
 datetime(const char *fmt)
 {
-	time_t t;
+	struct tm tm;
+	time_t t, next;
 
 	t = time(NULL);
-	if (!strftime(buf, sizeof(buf), fmt, localtime(&t))) {
+	tm = *localtime(&t);
+	if (!strftime(buf, sizeof(buf), fmt, &tm)) {
 		warn("strftime: Result string exceeds buffer size");
 		return NULL;
 	}
 
+	/* wake up right when the shown time changes */
+	switch (unit(fmt)) {
+	case 1:
+		next = t + 1;
+		break;
+	case 60:
+		next = t - tm.tm_sec + 60;
+		break;
+	case 60 * 60:
+		tm.tm_sec = tm.tm_min = 0;
+		tm.tm_hour++;
+		tm.tm_isdst = -1;
+		next = mktime(&tm);
+		break;
+	default:
+		tm.tm_sec = tm.tm_min = tm.tm_hour = 0;
+		tm.tm_mday++;
+		tm.tm_isdst = -1;
+		next = mktime(&tm);
+		break;
+	}
+	if (next > t)
+		wakeat((uintmax_t)next * 1000);
+
 	return buf;
 }
@@ -14,6 +14,22 @@
 #include "../slstatus.h"
 #include "../util.h"
 
+#if defined(__linux__)
+#include "../netlink.h"
+
+static const char *
+ip(const char *interface, unsigned short sa_family)
+{
+	const struct iface *f;
+	const char *addr;
+
+	if (!(f = iface(interface, 0)))
+		return NULL;
+	addr = sa_family == AF_INET ? f->ipv4 : f->ipv6;
+
+	return addr[0] ? addr : NULL;
+}
+#else
 static const char *
 ip(const char *interface, unsigned short sa_family)
 {
@@ -47,6 +63,7 @@ ip(const char *interface, unsigned short sa_family)
 
 	return NULL;
 }
+#endif
 
 const char *
 ipv4(const char *interface)
@@ -2,7 +2,6 @@
 #include <ctype.h>
 #include <stdio.h>
 #include <string.h>
-#include <X11/Xlib.h>
 
 #include "../slstatus.h"
 #include "../util.h"
@@ -17,18 +16,13 @@
 const char *
 keyboard_indicators(const char *fmt)
 {
-	Display *dpy;
-	XKeyboardState state;
+	const struct xkb *x;
 	size_t fmtlen, i, n;
 	int togglecase, isset;
 	char key;
 
-	if (!(dpy = XOpenDisplay(NULL))) {
-		warn("XOpenDisplay: Failed to open display");
+	if (!(x = xkb()))
 		return NULL;
-	}
-	XGetKeyboardControl(dpy, &state);
-	XCloseDisplay(dpy);
 
 	fmtlen = strnlen(fmt, 4);
 	for (i = n = 0; i < fmtlen; i++) {
@@ -37,7 +31,7 @@ keyboard_indicators(const char *fmt)
 			continue;
 
 		togglecase = (i + 1 >= fmtlen || fmt[i + 1] != '?');
-		isset = (state.led_mask & (1 << (key == 'n')));
+		isset = (x->leds & (1 << (key == 'n')));
 
 		if (togglecase)
 			buf[n++] = isset ? toupper(key) : key;
@@ -2,8 +2,6 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
-#include <X11/XKBlib.h>
-#include <X11/Xlib.h>
 
 #include "../slstatus.h"
 #include "../util.h"
@@ -47,40 +45,13 @@ get_layout(char *syms, int grp_num)
 const char *
 keymap(const char *unused)
 {
-	Display *dpy;
-	XkbDescRec *desc;
-	XkbStateRec state;
-	char *symbols;
-	const char *layout;
+	const struct xkb *x;
+	char symbols[sizeof(x->symbols)];
 
-	layout = NULL;
-
-	if (!(dpy = XOpenDisplay(NULL))) {
-		warn("XOpenDisplay: Failed to open display");
+	if (!(x = xkb()))
 		return NULL;
-	}
-	if (!(desc = XkbAllocKeyboard())) {
-		warn("XkbAllocKeyboard: Failed to allocate keyboard");
-		goto end;
-	}
-	if (XkbGetNames(dpy, XkbSymbolsNameMask, desc)) {
-		warn("XkbGetNames: Failed to retrieve key symbols");
-		goto end;
-	}
-	if (XkbGetState(dpy, XkbUseCoreKbd, &state)) {
-		warn("XkbGetState: Failed to retrieve keyboard state");
-		goto end;
-	}
-	if (!(symbols = XGetAtomName(dpy, desc->names->symbols))) {
-		warn("XGetAtomName: Failed to get atom name");
-		goto end;
-	}
-	layout = bprintf("%s", get_layout(symbols, state.group));
-	XFree(symbols);
-end:
-	XkbFreeKeyboard(desc, XkbSymbolsNameMask, 1);
-	if (XCloseDisplay(dpy))
-		warn("XCloseDisplay: Failed to close display");
+	/* get_layout() takes the string apart */
+	memcpy(symbols, x->symbols, sizeof(symbols));
 
-	return layout;
+	return bprintf("%s", get_layout(symbols, x->group));
 }
@@ -1,56 +1,52 @@
 /* See LICENSE file for copyright and license details. */
 #include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include "../slstatus.h"
 #include "../util.h"
 
-#if defined(__linux__)
-	#include <stdint.h>
+/* bytes per second since the previous call of this args[] entry */
+static const char *
+rate(uintmax_t bytes)
+{
+	struct {
+		uintmax_t bytes, t;
+	} *s = state(sizeof(*s));
+	uintmax_t old = s->bytes, t = now(), dt = t - s->t;
+	int first = !s->t;
+
+	s->bytes = bytes;
+	s->t = t;
+	if (first || !dt || bytes < old)
+		return NULL;
 
-	#define NET_RX_BYTES "/sys/class/net/%s/statistics/rx_bytes"
-	#define NET_TX_BYTES "/sys/class/net/%s/statistics/tx_bytes"
+	return fmt_human((bytes - old) * 1000 / dt, 1024);
+}
+
+#if defined(__linux__)
+	#include "../netlink.h"
 
 	const char *
 	netspeed_rx(const char *interface)
 	{
-		uintmax_t oldrxbytes;
-		static uintmax_t rxbytes;
-		extern const unsigned int interval;
-		char path[PATH_MAX];
+		const struct iface *f;
 
-		oldrxbytes = rxbytes;
-
-		if (esnprintf(path, sizeof(path), NET_RX_BYTES, interface) < 0)
-			return NULL;
-		if (pscanf(path, "%ju", &rxbytes) != 1)
-			return NULL;
-		if (oldrxbytes == 0)
+		if (!(f = iface(interface, IFACE_STATS)))
 			return NULL;
 
-		return fmt_human((rxbytes - oldrxbytes) * 1000 / interval,
-		                 1024);
+		return rate(f->rxbytes);
 	}
 
 	const char *
 	netspeed_tx(const char *interface)
 	{
-		uintmax_t oldtxbytes;
-		static uintmax_t txbytes;
-		extern const unsigned int interval;
-		char path[PATH_MAX];
+		const struct iface *f;
 
-		oldtxbytes = txbytes;
-
-		if (esnprintf(path, sizeof(path), NET_TX_BYTES, interface) < 0)
-			return NULL;
-		if (pscanf(path, "%ju", &txbytes) != 1)
-			return NULL;
-		if (oldtxbytes == 0)
+		if (!(f = iface(interface, IFACE_STATS)))
 			return NULL;
 
-		return fmt_human((txbytes - oldtxbytes) * 1000 / interval,
-		                 1024);
+		return rate(f->txbytes);
 	}
 #elif defined(__OpenBSD__) | defined(__FreeBSD__)
 	#include <ifaddrs.h>
@@ -64,13 +60,9 @@
 	{
 		struct ifaddrs *ifal, *ifa;
 		struct if_data *ifd;
-		uintmax_t oldrxbytes;
-		static uintmax_t rxbytes;
-		extern const unsigned int interval;
+		uintmax_t rxbytes;
 		int if_ok = 0;
 
-		oldrxbytes = rxbytes;
-
 		if (getifaddrs(&ifal) < 0) {
 			warn("getifaddrs failed");
 			return NULL;
@@ -86,11 +78,8 @@
 			warn("reading 'if_data' failed");
 			return NULL;
 		}
-		if (oldrxbytes == 0)
-			return NULL;
 
-		return fmt_human((rxbytes - oldrxbytes) * 1000 / interval,
-		                 1024);
+		return rate(rxbytes);
 	}
 
 	const char *
@@ -98,13 +87,9 @@
 	{
 		struct ifaddrs *ifal, *ifa;
 		struct if_data *ifd;
-		uintmax_t oldtxbytes;
-		static uintmax_t txbytes;
-		extern const unsigned int interval;
+		uintmax_t txbytes;
 		int if_ok = 0;
 
-		oldtxbytes = txbytes;
-
 		if (getifaddrs(&ifal) < 0) {
 			warn("getifaddrs failed");
 			return NULL;
@@ -120,10 +105,7 @@
 			warn("reading 'if_data' failed");
 			return NULL;
 		}
-		if (oldtxbytes == 0)
-			return NULL;
 
-		return fmt_human((txbytes - oldtxbytes) * 1000 / interval,
-		                 1024);
+		return rate(txbytes);
 	}
 #endif
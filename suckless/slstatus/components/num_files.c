@@ -6,27 +6,189 @@
 #include "../slstatus.h"
 #include "../util.h"
 
-const char *
-num_files(const char *path)
-{
-	struct dirent *dp;
-	DIR *dir;
-	int num;
-
-	if (!(dir = opendir(path))) {
-		warn("opendir '%s':", path);
-		return NULL;
+#if defined(__linux__)
+	#include <fcntl.h>
+	#include <stdint.h>
+	#include <sys/inotify.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+
+	/* count again once in a while, in case events got lost */
+	#define RESCAN (10 * 60 * 1000)
+
+	struct linux_dirent64 {
+		uint64_t d_ino;
+		int64_t d_off;
+		unsigned short d_reclen;
+		unsigned char d_type;
+		char d_name[];
+	};
+
+	/*
+	 * Directories are counted once, then kept up to date with inotify
+	 * events, which also wake up the main loop.
+	 */
+	static struct dir {
+		const char *path;
+		int wd;           /* -1 while not watched */
+		long count;
+		uintmax_t counted; /* when, 0 to count again */
+	} dirs[16];
+	static int ifd = -1;
+
+	static long
+	count(const char *path)
+	{
+		static union {
+			struct linux_dirent64 d;
+			char buf[65536];
+		} u;
+		struct linux_dirent64 *dp;
+		long n, off, num;
+		int fd;
+
+		if ((fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+			warn("open '%s':", path);
+			return -1;
+		}
+		num = 0;
+		while ((n = syscall(SYS_getdents64, fd, u.buf, sizeof(u.buf))) > 0) {
+			for (off = 0; off < n; off += dp->d_reclen) {
+				dp = (struct linux_dirent64 *)(u.buf + off);
+				if (!strcmp(dp->d_name, ".") ||
+				    !strcmp(dp->d_name, ".."))
+					continue; /* skip self and parent */
+				num++;
+			}
+		}
+		if (n < 0) {
+			warn("getdents64 '%s':", path);
+			num = -1;
+		}
+		close(fd);
+
+		return num;
+	}
+
+	/* apply the queued events, except to skip, which was just counted */
+	static void
+	events(const struct dir *skip)
+	{
+		static union {
+			struct inotify_event e;
+			char buf[4096];
+		} u;
+		struct inotify_event *e;
+		struct dir *d;
+		ssize_t n, off;
+		size_t i;
+
+		while ((n = read(ifd, u.buf, sizeof(u.buf))) > 0) {
+			for (off = 0; off < n; off += sizeof(*e) + e->len) {
+				e = (struct inotify_event *)(u.buf + off);
+				if (e->mask & IN_Q_OVERFLOW) {
+					for (i = 0; i < LEN(dirs); i++)
+						dirs[i].counted = 0;
+					continue;
+				}
+				for (i = 0, d = NULL; i < LEN(dirs) && !d; i++)
+					if (dirs[i].path && dirs[i].wd == e->wd)
+						d = &dirs[i];
+				if (!d || d == skip)
+					continue;
+				if (e->mask & (IN_CREATE | IN_MOVED_TO))
+					d->count++;
+				if (e->mask & (IN_DELETE | IN_MOVED_FROM))
+					d->count--;
+				if (e->mask & (IN_MOVE_SELF | IN_DELETE_SELF)) {
+					/*
+					 * the watch follows the inode, so watch
+					 * whatever is at path now
+					 */
+					inotify_rm_watch(ifd, d->wd);
+					d->wd = -1;
+					d->counted = 0;
+				}
+				if (e->mask & IN_IGNORED) {
+					/* watch dropped, e.g. on unmount */
+					d->wd = -1;
+					d->counted = 0;
+				}
+			}
+		}
 	}
 
-	num = 0;
-	while ((dp = readdir(dir))) {
-		if (!strcmp(dp->d_name, ".") || !strcmp(dp->d_name, ".."))
-			continue; /* skip self and parent */
+	const char *
+	num_files(const char *path)
+	{
+		struct dir *d = NULL;
+		size_t i;
+
+		for (i = 0; i < LEN(dirs) && !d; i++) {
+			if (!dirs[i].path) {
+				dirs[i].path = path;
+				dirs[i].wd = -1;
+			}
+			if (!strcmp(dirs[i].path, path))
+				d = &dirs[i];
+		}
+		if (!d) {
+			warn("num_files '%s': Too many directories", path);
+			return NULL;
+		}
+
+		if (ifd == -1 && (ifd = inotify_init1(IN_NONBLOCK |
+		                                      IN_CLOEXEC)) < 0) {
+			warn("inotify_init1:");
+			ifd = -2;
+		}
+		if (ifd >= 0) {
+			events(NULL);
+			if (d->wd < 0) {
+				d->counted = 0;
+				if ((d->wd = inotify_add_watch(ifd, path, IN_CREATE |
+				                               IN_DELETE | IN_MOVED_FROM |
+				                               IN_MOVED_TO | IN_MOVE_SELF |
+				                               IN_DELETE_SELF |
+				                               IN_ONLYDIR)) < 0)
+					warn("inotify_add_watch '%s':", path);
+			}
+			watchfd(ifd);
+		}
+
+		if (d->wd < 0 || !d->counted || now() - d->counted >= RESCAN) {
+			if ((d->count = count(path)) < 0)
+				return NULL;
+			d->counted = now();
+			if (ifd >= 0)
+				events(d);
+		}
 
-		num++;
+		return bprintf("%ld", d->count);
 	}
+#else
+	const char *
+	num_files(const char *path)
+	{
+		struct dirent *dp;
+		DIR *dir;
+		int num;
 
-	closedir(dir);
+		if (!(dir = opendir(path))) {
+			warn("opendir '%s':", path);
+			return NULL;
+		}
 
-	return bprintf("%d", num);
-}
+		num = 0;
+		while ((dp = readdir(dir))) {
+			if (!strcmp(dp->d_name, ".") || !strcmp(dp->d_name, ".."))
+				continue; /* skip self and parent */
+
+			num++;
+		}
+
+		closedir(dir);
+
+		return bprintf("%d", num);
+	}
+#endif
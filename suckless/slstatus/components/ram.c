@@ -5,73 +5,50 @@
 #include "../util.h"
 
 #if defined(__linux__)
-	#include <stdint.h>
-
 	const char *
 	ram_free(const char *unused)
 	{
-		uintmax_t free;
+		const struct meminfo *m;
 
-		if (pscanf("/proc/meminfo",
-		           "MemTotal: %ju kB\n"
-		           "MemFree: %ju kB\n"
-		           "MemAvailable: %ju kB\n",
-		           &free, &free, &free) != 3)
+		if (!(m = meminfo()))
 			return NULL;
 
-		return fmt_human(free * 1024, 1024);
+		return fmt_human(m->available * 1024, 1024);
 	}
 
 	const char *
 	ram_perc(const char *unused)
 	{
-		uintmax_t total, free, buffers, cached;
-		int percent;
-
-		if (pscanf("/proc/meminfo",
-		           "MemTotal: %ju kB\n"
-		           "MemFree: %ju kB\n"
-		           "MemAvailable: %ju kB\n"
-		           "Buffers: %ju kB\n"
-		           "Cached: %ju kB\n",
-		           &total, &free, &buffers, &buffers, &cached) != 5)
-			return NULL;
+		const struct meminfo *m;
 
-		if (total == 0)
+		if (!(m = meminfo()) || m->total == 0)
 			return NULL;
 
-		percent = 100 * ((total - free) - (buffers + cached)) / total;
-		return bprintf("%d", percent);
+		return bprintf("%d", (int)(100 * (m->total - m->free -
+		               m->buffers - m->cached) / m->total));
 	}
 
 	const char *
 	ram_total(const char *unused)
 	{
-		uintmax_t total;
+		const struct meminfo *m;
 
-		if (pscanf("/proc/meminfo", "MemTotal: %ju kB\n", &total)
-		    != 1)
+		if (!(m = meminfo()))
 			return NULL;
 
-		return fmt_human(total * 1024, 1024);
+		return fmt_human(m->total * 1024, 1024);
 	}
 
 	const char *
 	ram_used(const char *unused)
 	{
-		uintmax_t total, free, buffers, cached, used;
-
-		if (pscanf("/proc/meminfo",
-		           "MemTotal: %ju kB\n"
-		           "MemFree: %ju kB\n"
-		           "MemAvailable: %ju kB\n"
-		           "Buffers: %ju kB\n"
-		           "Cached: %ju kB\n",
-		           &total, &free, &buffers, &buffers, &cached) != 5)
+		const struct meminfo *m;
+
+		if (!(m = meminfo()))
 			return NULL;
 
-		used = (total - free - buffers - cached);
-		return fmt_human(used * 1024, 1024);
+		return fmt_human((m->total - m->free - m->buffers - m->cached)
+		                 * 1024, 1024);
 	}
 #elif defined(__OpenBSD__)
 	#include <stdlib.h>
@@ -1,31 +1,210 @@
 /* See LICENSE file for copyright and license details. */
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "../slstatus.h"
 #include "../util.h"
 
-const char *
-run_command(const char *cmd)
+extern char **environ;
+
+/*
+ * Commands run in the background: a call starts the command if it is not
+ * running and shows the last output meanwhile, the main loop calls again
+ * when output arrives or the command timed out.
+ */
+static struct job {
+	const char *cmd;
+	pid_t pid;
+	int fd;  /* read end of its stdout, -1 after EOF */
+	int tfd; /* fires after cmdtimeout */
+	int pfd; /* pidfd, readable once it exited after closing stdout */
+	size_t len;
+	int got;  /* the first line was taken */
+	char out[1024];
+	char last[1024];
+	int ok;
+} jobs[16];
+
+/* don't leave commands behind when slstatus exits */
+static void
+killjobs(void)
 {
-	char *p;
-	FILE *fp;
+	size_t i;
 
-	if (!(fp = popen(cmd, "r"))) {
-		warn("popen '%s':", cmd);
+	for (i = 0; i < LEN(jobs); i++)
+		if (jobs[i].pid > 0)
+			kill(-jobs[i].pid, SIGTERM);
+}
+
+static struct job *
+job(const char *cmd)
+{
+	size_t i;
+
+	for (i = 0; i < LEN(jobs) && jobs[i].cmd; i++)
+		if (jobs[i].cmd == cmd)
+			return &jobs[i];
+	if (i == LEN(jobs)) {
+		warn("run_command '%s': Too many commands", cmd);
 		return NULL;
 	}
+	if (i == 0)
+		atexit(killjobs);
+	jobs[i].cmd = cmd;
+	jobs[i].fd = jobs[i].tfd = jobs[i].pfd = -1;
 
-	p = fgets(buf, sizeof(buf) - 1, fp);
-	if (pclose(fp) < 0) {
-		warn("pclose '%s':", cmd);
-		return NULL;
+	return &jobs[i];
+}
+
+static void
+closefd(int *fd)
+{
+	if (*fd < 0)
+		return;
+	unwatchfd(*fd);
+	close(*fd);
+	*fd = -1;
+}
+
+static void
+spawn(struct job *j)
+{
+	extern const unsigned int cmdtimeout;
+	struct itimerspec its = { .it_value = {
+		.tv_sec = cmdtimeout / 1000,
+		.tv_nsec = cmdtimeout % 1000 * 1000000 } };
+	posix_spawn_file_actions_t fa;
+	posix_spawnattr_t attr;
+	sigset_t none;
+	char *argv[] = { "/bin/sh", "-c", (char *)j->cmd, NULL };
+	int p[2], err;
+
+	if (pipe(p) < 0) {
+		warn("pipe:");
+		return;
+	}
+	if ((j->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK |
+	                             TFD_CLOEXEC)) < 0) {
+		warn("timerfd_create:");
+		close(p[0]);
+		close(p[1]);
+		return;
+	}
+	fcntl(p[0], F_SETFD, FD_CLOEXEC);
+	fcntl(p[1], F_SETFD, FD_CLOEXEC);
+	fcntl(p[0], F_SETFL, O_NONBLOCK);
+
+	/* its own process group to kill pipelines as a whole, and none
+	 * of the signals blocked for the main loop */
+	sigemptyset(&none);
+	posix_spawn_file_actions_init(&fa);
+	posix_spawn_file_actions_adddup2(&fa, p[1], STDOUT_FILENO);
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setsigmask(&attr, &none);
+	posix_spawnattr_setpgroup(&attr, 0);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK |
+	                         POSIX_SPAWN_SETPGROUP);
+	err = posix_spawn(&j->pid, argv[0], &fa, &attr, argv, environ);
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&fa);
+	close(p[1]);
+	if (err) {
+		errno = err;
+		warn("posix_spawn '%s':", j->cmd);
+		j->pid = 0;
+		close(p[0]);
+		closefd(&j->tfd);
+		return;
+	}
+
+	j->fd = p[0];
+	j->len = 0;
+	j->got = 0;
+	timerfd_settime(j->tfd, 0, &its, NULL);
+	watchfd(j->fd);
+	watchfd(j->tfd);
+	pending(1);
+}
+
+static void
+collect(struct job *j)
+{
+	char tmp[4096];
+	uint64_t expired;
+	ssize_t n = 0;
+	size_t len;
+
+	while (j->fd >= 0 && (n = read(j->fd, tmp, sizeof(tmp))) > 0) {
+		len = MIN((size_t)n, sizeof(j->out) - 1 - j->len);
+		memcpy(j->out + j->len, tmp, len);
+		j->len += len;
+	}
+	/* the first line is the result, as with popen() and fgets() */
+	if (j->fd >= 0 && !j->got &&
+	    (memchr(j->out, '\n', j->len) || n == 0)) {
+		j->out[j->len] = '\0';
+		j->out[strcspn(j->out, "\n")] = '\0';
+		memcpy(j->last, j->out, sizeof(j->last));
+		j->ok = j->out[0] != '\0';
+		j->got = 1;
+		pending(-1);
+	}
+	if (j->fd >= 0 && (n == 0 || errno != EAGAIN)) {
+		if (n < 0)
+			warn("read '%s':", j->cmd);
+		closefd(&j->fd);
 	}
-	if (!p)
+
+	/* a command that is done did not time out, whatever the timer says */
+	if (waitpid(j->pid, NULL, WNOHANG) == j->pid) {
+		closefd(&j->fd);
+	} else if (read(j->tfd, &expired, sizeof(expired)) > 0) {
+		/* the last good output stays */
+		warn("run_command '%s': Timed out", j->cmd);
+		kill(-j->pid, SIGKILL);
+		closefd(&j->fd);
+		waitpid(j->pid, NULL, 0);
+	} else {
+		/* running, or gone with stdout but not exited yet: wake up
+		 * when it exits, without a pidfd when the timer fires */
+#ifdef SYS_pidfd_open
+		if (j->fd < 0 && j->pfd < 0 &&
+		    (j->pfd = syscall(SYS_pidfd_open, j->pid, 0)) >= 0)
+			watchfd(j->pfd);
+#endif
+		return;
+	}
+
+	j->pid = 0;
+	closefd(&j->tfd);
+	closefd(&j->pfd);
+	if (!j->got)
+		pending(-1);
+}
+
+const char *
+run_command(const char *cmd)
+{
+	struct job *j;
+
+	if (!(j = job(cmd)))
 		return NULL;
 
-	if ((p = strrchr(buf, '\n')))
-		p[0] = '\0';
+	/* a call for a running command only picks up what it did */
+	if (j->pid)
+		collect(j);
+	else
+		spawn(j);
 
-	return buf[0] ? buf : NULL;
+	return j->ok ? j->last : NULL;
 }
@@ -13,7 +13,7 @@
 	{
 		uintmax_t temp;
 
-		if (pscanf(file, "%ju", &temp) != 1)
+		if (kreadu(file, &temp) < 0)
 			return NULL;
 
 		return bprintf("%ju", temp / 1000);
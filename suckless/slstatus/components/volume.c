@@ -183,8 +183,55 @@
 		return bprintf("%d", value);
 	}
 #else
+	#include <ctype.h>
+	#include <errno.h>
+	#include <sound/asound.h>
+	#include <stdlib.h>
 	#include <sys/soundcard.h>
 
+	/*
+	 * The OSS mixer can't tell about changes, the ALSA control device of
+	 * the same card (/dev/mixerN is card N) can.
+	 */
+	static void
+	watchmixer(const char *card)
+	{
+		static int fd = -1;
+		struct snd_ctl_event ev;
+		const char *p;
+		char path[32];
+		ssize_t n;
+		int sub = 1;
+
+		if (fd == -1) {
+			for (p = card + strlen(card); p > card && isdigit(p[-1]); p--)
+				;
+			if (esnprintf(path, sizeof(path), "/dev/snd/controlC%d",
+			              *p ? atoi(p) : 0) < 0 ||
+			    (fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC)) < 0) {
+				fd = -2;
+			} else if (ioctl(fd, SNDRV_CTL_IOCTL_SUBSCRIBE_EVENTS,
+			                 &sub) < 0) {
+				warn("ioctl 'SNDRV_CTL_IOCTL_SUBSCRIBE_EVENTS':");
+				close(fd);
+				fd = -2;
+			}
+		}
+		if (fd < 0)
+			return;
+
+		while ((n = read(fd, &ev, sizeof(ev))) > 0)
+			;
+		/* the card is gone, try to open it again next time */
+		if (n < 0 && errno != EAGAIN) {
+			unwatchfd(fd);
+			close(fd);
+			fd = -1;
+			return;
+		}
+		watchfd(fd);
+	}
+
 	const char *
 	vol_perc(const char *card)
 	{
@@ -192,6 +239,7 @@
 		int v, afd, devmask;
 		char *vnames[] = SOUND_DEVICE_NAMES;
 
+		watchmixer(card);
 		if ((afd = open(card, O_RDONLY | O_NONBLOCK)) < 0) {
 			warn("open '%s':", card);
 			return NULL;
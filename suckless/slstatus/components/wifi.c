@@ -15,86 +15,32 @@
 			(2 * (rssi + 100)))
 
 #if defined(__linux__)
-	#include <limits.h>
-	#include <linux/wireless.h>
+	#include <linux/if.h>
+	#include <stdint.h>
 
-	#define NET_OPERSTATE "/sys/class/net/%s/operstate"
+	#include "../netlink.h"
 
 	const char *
 	wifi_perc(const char *interface)
 	{
-		int cur;
-		size_t i;
-		char *p, *datastart;
-		char path[PATH_MAX];
-		char status[5];
-		FILE *fp;
-
-		if (esnprintf(path, sizeof(path), NET_OPERSTATE, interface) < 0)
-			return NULL;
-		if (!(fp = fopen(path, "r"))) {
-			warn("fopen '%s':", path);
-			return NULL;
-		}
-		p = fgets(status, 5, fp);
-		fclose(fp);
-		if (!p || strcmp(status, "up\n") != 0)
-			return NULL;
-
-		if (!(fp = fopen("/proc/net/wireless", "r"))) {
-			warn("fopen '/proc/net/wireless':");
-			return NULL;
-		}
-
-		for (i = 0; i < 3; i++)
-			if (!(p = fgets(buf, sizeof(buf) - 1, fp)))
-				break;
-
-		fclose(fp);
-		if (i < 2 || !p)
-			return NULL;
+		const struct iface *f;
 
-		if (!(datastart = strstr(buf, interface)))
+		if (!(f = iface(interface, IFACE_SIGNAL)) || !f->wifi ||
+		    f->operstate != IF_OPER_UP || !f->signal)
 			return NULL;
 
-		datastart = (datastart+(strlen(interface)+1));
-		sscanf(datastart + 1, " %*d   %d  %*d  %*d\t\t  %*d\t   "
-		       "%*d\t\t%*d\t\t %*d\t  %*d\t\t %*d", &cur);
-
-		/* 70 is the max of /proc/net/wireless */
-		return bprintf("%d", (int)((float)cur / 70 * 100));
+		return bprintf("%d", RSSI_TO_PERC(f->signal));
 	}
 
 	const char *
 	wifi_essid(const char *interface)
 	{
-		static char id[IW_ESSID_MAX_SIZE+1];
-		int sockfd;
-		struct iwreq wreq;
-
-		memset(&wreq, 0, sizeof(struct iwreq));
-		wreq.u.essid.length = IW_ESSID_MAX_SIZE+1;
-		if (esnprintf(wreq.ifr_name, sizeof(wreq.ifr_name), "%s",
-		              interface) < 0)
-			return NULL;
-
-		if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
-			warn("socket 'AF_INET':");
-			return NULL;
-		}
-		wreq.u.essid.pointer = id;
-		if (ioctl(sockfd,SIOCGIWESSID, &wreq) < 0) {
-			warn("ioctl 'SIOCGIWESSID':");
-			close(sockfd);
-			return NULL;
-		}
-
-		close(sockfd);
+		const struct iface *f;
 
-		if (!strcmp(id, ""))
+		if (!(f = iface(interface, 0)) || !f->wifi || !f->essid[0])
 			return NULL;
 
-		return id;
+		return f->essid;
 	}
 #elif defined(__OpenBSD__)
 	#include <net/if.h>
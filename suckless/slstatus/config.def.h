@@ -1,8 +1,11 @@
 /* See LICENSE file for copyright and license details. */
 
-/* interval between updates (in ms) */
+/* interval between updates (in ms), components can set their own */
 const unsigned int interval = 1000;
 
+/* run_command: kill commands running longer than this (in ms) */
+const unsigned int cmdtimeout = 10000;
+
 /* text to show if no value can be retrieved */
 static const char unknown_str[] = "n/a";
 
@@ -20,8 +23,10 @@ static const char unknown_str[] = "n/a";
  *                                                     NULL on OpenBSD/FreeBSD
  * cat                 read arbitrary file             path
  * cpu_freq            cpu frequency in MHz            NULL
- * cpu_perc            cpu usage in percent            NULL
- * datetime            date and time                   format string (%F %T)
+ * cpu_perc            cpu usage in percent            NULL for all cores,
+ *                                                     core number (0) on Linux
+ * datetime            date and time, updated right    format string (%F %T)
+ *                     when it changes
  * disk_free           free disk space in GB           mountpoint path (/)
  * disk_perc           disk usage in percent           mountpoint path (/)
  * disk_total          total disk space in GB          mountpoint path (/)
@@ -64,16 +69,16 @@ static const char unknown_str[] = "n/a";
  * wifi_perc           WiFi signal in percent          interface name (wlan0)
  */
 static const struct arg args[] = {
-	/* function format          argument */
+	/* function format          argument       interval (ms, 0: default) */
 /* { kernel_release, "^c#d791a8^  Debian %s ", NULL }, */
 /* { disk_perc, "^c#d791a8^  Disk: ^c#FFFFFF^%s%%", "/", NULL }, */
 /*  { keyboard_indicators, "^c#d791a8^ Caps: ^c#FFFFFF^%s", "caps", NULL }, */
 /*   { keyboard_indicators, "^c#d791a8^ Num: ^c#FFFFFF^%s", "num", NULL }, */
-/* { run_command, "^c#d791a8^  %s", "~/scripts/check_updates.sh" }, */
- /* { run_command, "^c#d791a8^  Updates: ^c#FFFFFF^%s",  "aptitude search '~U' | wc -l" }, */
-	{ cpu_perc, "^c#d791a8^  CPU: ^c#FFFFFF^%s%%", 	NULL },
-	{ ram_perc, "^c#d791a8^  RAM: ^c#FFFFFF^%s%%",	 NULL },
-	{ datetime, "^c#d791a8^  %s", 		"%a %b %-d" },
+/* { run_command, "^c#d791a8^  %s", "~/scripts/check_updates.sh", 3600000 }, */
+ /* { run_command, "^c#d791a8^  Updates: ^c#FFFFFF^%s",  "aptitude search '~U' | wc -l", 3600000 }, */
+	{ cpu_perc, "^c#d791a8^  CPU: ^c#FFFFFF^%s%%", 	NULL,		0 },
+	{ ram_perc, "^c#d791a8^  RAM: ^c#FFFFFF^%s%%",	 NULL,		0 },
+	{ datetime, "^c#d791a8^  %s", 		"%a %b %-d",	0 },
 /*	{ datetime, "^c#FFFFFF^ %s", 		"%H:%M  " }, */
- 	{ datetime, "^c#FFFFFF^ %s", 		"%l:%M %p  " },	
+ 	{ datetime, "^c#FFFFFF^ %s", 		"%l:%M %p  ",	0 },	
 	};
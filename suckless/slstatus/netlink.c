@@ -0,0 +1,408 @@
+/* See LICENSE file for copyright and license details. */
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/genetlink.h>
+#include <linux/if.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/nl80211.h>
+#include <linux/rtnetlink.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "slstatus.h"
+#include "util.h"
+#include "netlink.h"
+
+/*
+ * One rtnetlink socket subscribed to link and address changes and one
+ * generic netlink socket subscribed to nl80211 events keep a table of
+ * the interfaces up to date. Only what events don't cover is asked for
+ * again: the counters and the wifi signal, at most once per tick.
+ */
+enum { LINKS = 1, ADDRS = 2, WIFI = 4 };
+
+static struct iface ifaces[32];
+static int rtfd = -1, genfd = -1;
+static int dirty = LINKS | ADDRS | WIFI;
+static unsigned int seq;
+static uint16_t nl80211; /* generic netlink family id */
+
+struct req {
+	struct nlmsghdr n;
+	union {
+		struct ifinfomsg i;
+		struct ifaddrmsg a;
+		struct genlmsghdr g;
+	} u;
+	char attrs[64];
+};
+
+static void
+parseattrs(struct rtattr *rta, int len, struct rtattr **tb, int max)
+{
+	int type;
+
+	memset(tb, 0, sizeof(*tb) * (max + 1));
+	for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+		if ((type = rta->rta_type & NLA_TYPE_MASK) <= max)
+			tb[type] = rta;
+}
+
+static void
+addattr(struct nlmsghdr *n, int type, const void *data, int len)
+{
+	struct rtattr *rta;
+
+	rta = (struct rtattr *)((char *)n + NLMSG_ALIGN(n->nlmsg_len));
+	rta->rta_type = type;
+	rta->rta_len = RTA_LENGTH(len);
+	memcpy(RTA_DATA(rta), data, len);
+	n->nlmsg_len = NLMSG_ALIGN(n->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+}
+
+static struct iface *
+find(int index, int create)
+{
+	struct iface *f = NULL;
+	size_t i;
+
+	for (i = 0; i < LEN(ifaces); i++) {
+		if (ifaces[i].index == index)
+			return &ifaces[i];
+		if (!ifaces[i].index && !f)
+			f = &ifaces[i];
+	}
+	if (!create || !f)
+		return NULL;
+	memset(f, 0, sizeof(*f));
+	f->index = index;
+
+	return f;
+}
+
+static void
+rtmsg(struct nlmsghdr *n)
+{
+	struct rtattr *tb[IFLA_MAX + 1];
+	struct ifinfomsg *ifi = NLMSG_DATA(n);
+	struct ifaddrmsg *ifa = NLMSG_DATA(n);
+	struct rtnl_link_stats64 st;
+	struct rtattr *addr;
+	struct iface *f;
+	char *dst;
+
+	switch (n->nlmsg_type) {
+	case RTM_NEWLINK:
+		if (!(f = find(ifi->ifi_index, 1)))
+			return;
+		f->flags = ifi->ifi_flags;
+		parseattrs(IFLA_RTA(ifi), IFLA_PAYLOAD(n), tb, IFLA_MAX);
+		if (tb[IFLA_IFNAME])
+			esnprintf(f->name, sizeof(f->name), "%s",
+			          (char *)RTA_DATA(tb[IFLA_IFNAME]));
+		if (tb[IFLA_OPERSTATE])
+			f->operstate = *(unsigned char *)RTA_DATA(tb[IFLA_OPERSTATE]);
+		if (tb[IFLA_STATS64] &&
+		    RTA_PAYLOAD(tb[IFLA_STATS64]) >= sizeof(st)) {
+			memcpy(&st, RTA_DATA(tb[IFLA_STATS64]), sizeof(st));
+			f->rxbytes = st.rx_bytes;
+			f->txbytes = st.tx_bytes;
+		}
+		break;
+	case RTM_DELLINK:
+		if ((f = find(ifi->ifi_index, 0)))
+			memset(f, 0, sizeof(*f));
+		break;
+	case RTM_NEWADDR:
+		if (!(f = find(ifa->ifa_index, 0)))
+			return;
+		parseattrs(IFA_RTA(ifa), IFA_PAYLOAD(n), tb, IFA_MAX);
+		/* like getifaddrs(), the local end of point-to-point links */
+		if (!(addr = tb[IFA_LOCAL]))
+			addr = tb[IFA_ADDRESS];
+		dst = ifa->ifa_family == AF_INET ? f->ipv4 :
+		      ifa->ifa_family == AF_INET6 ? f->ipv6 : NULL;
+		if (addr && dst && !dst[0] &&
+		    !inet_ntop(ifa->ifa_family, RTA_DATA(addr), dst, sizeof(f->ipv6)))
+			dst[0] = '\0';
+		break;
+	case RTM_DELADDR:
+		/* another address might take its place, ask for all again */
+		dirty |= ADDRS;
+		break;
+	}
+}
+
+static void
+ctrlmsg(struct nlmsghdr *n)
+{
+	struct rtattr *tb[CTRL_ATTR_MAX + 1], *grp[CTRL_ATTR_MCAST_GRP_MAX + 1];
+	struct genlmsghdr *g = NLMSG_DATA(n);
+	struct rtattr *rta;
+	const char *name;
+	uint32_t id;
+	int len;
+
+	parseattrs((struct rtattr *)((char *)g + GENL_HDRLEN),
+	           n->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN), tb, CTRL_ATTR_MAX);
+	if (!tb[CTRL_ATTR_FAMILY_ID])
+		return;
+	nl80211 = *(uint16_t *)RTA_DATA(tb[CTRL_ATTR_FAMILY_ID]);
+	if (!(rta = tb[CTRL_ATTR_MCAST_GROUPS]))
+		return;
+
+	/* connects, disconnects and interfaces coming and going */
+	len = RTA_PAYLOAD(rta);
+	for (rta = RTA_DATA(rta); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		parseattrs(RTA_DATA(rta), RTA_PAYLOAD(rta), grp,
+		           CTRL_ATTR_MCAST_GRP_MAX);
+		if (!grp[CTRL_ATTR_MCAST_GRP_NAME] || !grp[CTRL_ATTR_MCAST_GRP_ID])
+			continue;
+		name = RTA_DATA(grp[CTRL_ATTR_MCAST_GRP_NAME]);
+		id = *(uint32_t *)RTA_DATA(grp[CTRL_ATTR_MCAST_GRP_ID]);
+		if ((!strcmp(name, "mlme") || !strcmp(name, "config")) &&
+		    setsockopt(genfd, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP,
+		               &id, sizeof(id)) < 0)
+			warn("setsockopt 'NETLINK_ADD_MEMBERSHIP':");
+	}
+}
+
+static void
+nl80211msg(struct nlmsghdr *n)
+{
+	struct rtattr *tb[NL80211_ATTR_MAX + 1];
+	struct rtattr *sta[NL80211_STA_INFO_MAX + 1];
+	struct genlmsghdr *g = NLMSG_DATA(n);
+	struct iface *f;
+	size_t len;
+
+	parseattrs((struct rtattr *)((char *)g + GENL_HDRLEN),
+	           n->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN), tb,
+	           NL80211_ATTR_MAX);
+	/* replies to our requests come with a sequence number */
+	if (!n->nlmsg_seq) {
+		dirty |= WIFI;
+		return;
+	}
+	if (!tb[NL80211_ATTR_IFINDEX] ||
+	    !(f = find(*(uint32_t *)RTA_DATA(tb[NL80211_ATTR_IFINDEX]), 0)))
+		return;
+
+	switch (g->cmd) {
+	case NL80211_CMD_NEW_INTERFACE:
+		f->wifi = 1;
+		f->essid[0] = '\0';
+		if (tb[NL80211_ATTR_SSID]) {
+			len = MIN(RTA_PAYLOAD(tb[NL80211_ATTR_SSID]),
+			          sizeof(f->essid) - 1);
+			memcpy(f->essid, RTA_DATA(tb[NL80211_ATTR_SSID]), len);
+			f->essid[len] = '\0';
+		}
+		break;
+	case NL80211_CMD_NEW_STATION:
+		if (!tb[NL80211_ATTR_STA_INFO])
+			return;
+		parseattrs(RTA_DATA(tb[NL80211_ATTR_STA_INFO]),
+		           RTA_PAYLOAD(tb[NL80211_ATTR_STA_INFO]), sta,
+		           NL80211_STA_INFO_MAX);
+		if (sta[NL80211_STA_INFO_SIGNAL])
+			f->signal = *(int8_t *)RTA_DATA(sta[NL80211_STA_INFO_SIGNAL]);
+		break;
+	}
+}
+
+/* handle what arrived on fd, with a sequence number wait for its reply */
+static int
+nlread(int fd, unsigned int s)
+{
+	static union {
+		struct nlmsghdr n;
+		char buf[32768];
+	} msg;
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	struct nlmsghdr *n;
+	ssize_t len;
+
+	for (;;) {
+		if ((len = recv(fd, &msg, sizeof(msg), 0)) < 0) {
+			if (errno == EINTR ||
+			    (errno == EAGAIN && s && poll(&pfd, 1, 1000) > 0))
+				continue;
+			if (errno == ENOBUFS) {
+				/* events were dropped */
+				dirty = LINKS | ADDRS | WIFI;
+				continue;
+			}
+			if (errno != EAGAIN)
+				warn("recv 'netlink':");
+			return s ? -1 : 0;
+		}
+		for (n = &msg.n; NLMSG_OK(n, len); n = NLMSG_NEXT(n, len)) {
+			if (s && n->nlmsg_seq == s) {
+				if (n->nlmsg_type == NLMSG_DONE)
+					return 0;
+				if (n->nlmsg_type == NLMSG_ERROR)
+					return ((struct nlmsgerr *)NLMSG_DATA(n))->error;
+			}
+			if (fd == rtfd)
+				rtmsg(n);
+			else if (n->nlmsg_type == GENL_ID_CTRL)
+				ctrlmsg(n);
+			else if (nl80211 && n->nlmsg_type == nl80211)
+				nl80211msg(n);
+			if (s && n->nlmsg_seq == s && !(n->nlmsg_flags & NLM_F_MULTI))
+				return 0;
+		}
+	}
+}
+
+static int
+request(int fd, struct req *r)
+{
+	r->n.nlmsg_flags |= NLM_F_REQUEST;
+	r->n.nlmsg_seq = ++seq;
+	if (send(fd, r, r->n.nlmsg_len, 0) < 0) {
+		warn("send 'netlink':");
+		return -1;
+	}
+
+	return nlread(fd, seq);
+}
+
+static int
+dump(int fd, int type, int family)
+{
+	struct req r = { .n = {
+		.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtgenmsg)),
+		.nlmsg_type = type,
+		.nlmsg_flags = NLM_F_DUMP } };
+
+	r.u.i.ifi_family = family;
+
+	return request(fd, &r);
+}
+
+static int
+genrequest(int type, int cmd, int flags, int attr, const void *data,
+           int len)
+{
+	struct req r = { .n = {
+		.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN),
+		.nlmsg_type = type,
+		.nlmsg_flags = flags } };
+
+	r.u.g.cmd = cmd;
+	r.u.g.version = 1;
+	if (attr)
+		addattr(&r.n, attr, data, len);
+
+	return request(genfd, &r);
+}
+
+static int
+nlopen(int protocol, unsigned int groups)
+{
+	struct sockaddr_nl sa = { .nl_family = AF_NETLINK, .nl_groups = groups };
+	int fd;
+
+	if ((fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+	                 protocol)) < 0) {
+		warn("socket 'AF_NETLINK':");
+		return -1;
+	}
+	if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+		warn("bind 'AF_NETLINK':");
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int
+nlinit(void)
+{
+	if (rtfd != -1)
+		return rtfd >= 0;
+
+	if ((rtfd = nlopen(NETLINK_ROUTE, RTMGRP_LINK | RTMGRP_IPV4_IFADDR |
+	                   RTMGRP_IPV6_IFADDR)) < 0) {
+		rtfd = -2;
+		return 0;
+	}
+	/* without wifi drivers there is no nl80211, that's fine */
+	if ((genfd = nlopen(NETLINK_GENERIC, 0)) >= 0 &&
+	    (genrequest(GENL_ID_CTRL, CTRL_CMD_GETFAMILY, 0,
+	                CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME,
+	                sizeof(NL80211_GENL_NAME)) < 0 || !nl80211)) {
+		close(genfd);
+		genfd = -1;
+	}
+
+	return 1;
+}
+
+const struct iface *
+iface(const char *name, int what)
+{
+	static unsigned int statstick;
+	struct iface *f;
+	uint32_t index;
+	size_t i;
+
+	if (!nlinit())
+		return NULL;
+
+	nlread(rtfd, 0);
+	if (genfd >= 0)
+		nlread(genfd, 0);
+
+	if ((dirty & LINKS) || ((what & IFACE_STATS) && statstick != tick)) {
+		dirty &= ~LINKS;
+		statstick = tick;
+		dump(rtfd, RTM_GETLINK, AF_UNSPEC);
+	}
+	if (dirty & ADDRS) {
+		dirty &= ~ADDRS;
+		for (i = 0; i < LEN(ifaces); i++)
+			ifaces[i].ipv4[0] = ifaces[i].ipv6[0] = '\0';
+		dump(rtfd, RTM_GETADDR, AF_UNSPEC);
+	}
+	if (genfd >= 0 && (dirty & WIFI)) {
+		dirty &= ~WIFI;
+		for (i = 0; i < LEN(ifaces); i++)
+			ifaces[i].wifi = 0;
+		genrequest(nl80211, NL80211_CMD_GET_INTERFACE, NLM_F_DUMP,
+		           0, NULL, 0);
+	}
+
+	for (i = 0, f = NULL; i < LEN(ifaces) && !f; i++)
+		if (ifaces[i].index && !strcmp(ifaces[i].name, name))
+			f = &ifaces[i];
+	if (!f)
+		return NULL;
+
+	if ((what & IFACE_SIGNAL) && f->wifi && f->signaltick != tick) {
+		f->signaltick = tick;
+		f->signal = 0;
+		index = f->index;
+		genrequest(nl80211, NL80211_CMD_GET_STATION, NLM_F_DUMP,
+		           NL80211_ATTR_IFINDEX, &index, sizeof(index));
+	}
+
+	/* counters change all the time without events, the interval
+	 * takes care of them */
+	if (!(what & IFACE_STATS)) {
+		watchfd(rtfd);
+		if (genfd >= 0)
+			watchfd(genfd);
+	}
+
+	return f;
+}
+#endif
@@ -0,0 +1,22 @@
+/* See LICENSE file for copyright and license details. */
+
+/* network interfaces as told by rtnetlink and nl80211, Linux only */
+struct iface {
+	int index;
+	char name[16];
+	unsigned int flags;       /* IFF_* */
+	unsigned char operstate;  /* IF_OPER_* */
+	uintmax_t rxbytes, txbytes;
+	char ipv4[46], ipv6[46];  /* the first address, "" for none */
+	int wifi;
+	char essid[33];
+	int signal;               /* in dBm, 0 if unknown */
+	unsigned int signaltick;
+};
+
+enum {
+	IFACE_STATS  = 1 << 0, /* counters as of this tick */
+	IFACE_SIGNAL = 1 << 1, /* wifi signal as of this tick */
+};
+
+const struct iface *iface(const char *name, int what);
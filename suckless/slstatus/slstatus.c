@@ -1,10 +1,16 @@
 /* See LICENSE file for copyright and license details. */
 #include <errno.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
 #include <time.h>
+#include <unistd.h>
+#include <X11/XKBlib.h>
 #include <X11/Xlib.h>
 
 #include "arg.h"
@@ -15,51 +21,516 @@ struct arg {
 	const char *(*func)(const char *);
 	const char *fmt;
 	const char *args;
+	unsigned int interval; /* in ms, 0 means the global interval */
 };
 
 char buf[1024];
+unsigned int tick;
 static volatile sig_atomic_t done;
 static Display *dpy;
 
 #include "config.h"
 
+/* output of each component and when it is due again, in ms */
+static char blocks[LEN(args)][MAXLEN];
+static uintmax_t due[LEN(args)];
+static int wake[LEN(args)]; /* a watched fd became readable */
+static uintmax_t at[LEN(args)]; /* see wakeat() */
+static void *states[LEN(args)]; /* see state() */
+static volatile sig_atomic_t refresh;
+
+/* fds components asked to be woken up by, see watchfd() */
+static struct {
+	int fd;
+	size_t arg;
+} watches[64];
+static size_t nwatches;
+static size_t cur; /* component being evaluated */
+static int npending, once;
+static int epfd = -1, sigfd = -1, tfd = -1, clockfd = -1;
+
+/* per component cost with -p, dumped on SIGUSR2 */
+static struct {
+	uintmax_t calls, fails, ns, rwcalls;
+	uintmax_t hist[6]; /* < 10us, 100us, 1ms, 10ms, 100ms, more */
+} prof[LEN(args)];
+static int pflag, iofd = -1;
+
+/* keyboard state, kept up to date by Xkb events, see xkb() */
+static struct xkb xkbcache;
+static int xkbevent = -1;
+
 static void
 terminate(const int signo)
 {
 	if (signo != SIGUSR1)
 		done = 1;
+	else
+		refresh = 1;
+}
+
+/* counts suspend too, so deadlines taken from the wall clock hold */
+uintmax_t
+now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_BOOTTIME, &ts) < 0)
+		die("clock_gettime:");
+
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uintmax_t
+wallnow(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_REALTIME, &ts) < 0)
+		die("clock_gettime:");
+
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Evaluate the calling component again when the wall clock reaches t
+ * (in ms since the epoch) instead of after its interval.
+ */
+void
+wakeat(uintmax_t t)
+{
+	uintmax_t wall = wallnow();
+
+	/* a ms late rather than early, both clocks are read truncated */
+	at[cur] = now() + (t > wall ? t - wall : 0) + 1;
+}
+
+static uintmax_t
+nsnow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * read and write like syscalls so far (syscr + syscw, see proc(5)
+ * /proc/pid/io), not open, close, stat, poll or netlink sendmsg/recvmsg
+ */
+static uintmax_t
+rwcalls(void)
+{
+	char io[512];
+	uintmax_t r = 0, w = 0;
+	ssize_t n;
+
+	if (iofd < 0 || (n = pread(iofd, io, sizeof(io) - 1, 0)) <= 0)
+		return 0;
+	io[n] = '\0';
+	kscanu(kfield(io, "syscr:"), &r);
+	kscanu(kfield(io, "syscw:"), &w);
+
+	return r + w;
+}
+
+static const char *
+profile(size_t i)
+{
+	const char *res;
+	uintmax_t ns, sys;
+	size_t b;
+
+	sys = rwcalls();
+	ns = nsnow();
+	res = args[i].func(args[i].args);
+	ns = nsnow() - ns;
+	/* not counting the pread() of the first rwcalls() */
+	sys = rwcalls() - sys;
+	if (sys)
+		sys--;
+
+	prof[i].calls++;
+	prof[i].fails += !res;
+	prof[i].ns += ns;
+	prof[i].rwcalls += sys;
+	for (b = 0, ns /= 10000; ns && b < LEN(prof[i].hist) - 1; b++)
+		ns /= 10;
+	prof[i].hist[b]++;
+
+	return res;
+}
+
+static void
+dumpprofile(void)
+{
+	size_t i, b;
+
+	fprintf(stderr, "%3s %8s %6s %9s %9s %s\n", "#", "calls", "fails",
+	        "avg us", "rw calls", "<10us <100us <1ms <10ms <100ms more");
+	for (i = 0; i < LEN(args); i++) {
+		if (!prof[i].calls)
+			continue;
+		fprintf(stderr, "%3zu %8ju %6ju %9ju %9.1f", i, prof[i].calls,
+		        prof[i].fails, prof[i].ns / prof[i].calls / 1000,
+		        (double)prof[i].rwcalls / prof[i].calls);
+		for (b = 0; b < LEN(prof[i].hist); b++)
+			fprintf(stderr, " %ju", prof[i].hist[b]);
+		fprintf(stderr, "  %s\n", args[i].args ? args[i].args : "NULL");
+	}
+}
+
+static unsigned int
+period(size_t i)
+{
+	return args[i].interval ? args[i].interval : interval;
+}
+
+/*
+ * Evaluate the components whose deadline has passed and keep their
+ * formatted output. Deadlines stay on multiples of the period since
+ * start, so components with related periods share wakeups, and one
+ * due within an eighth of its period is run early for the same reason.
+ */
+static void
+update(uintmax_t t, int all)
+{
+	const char *res;
+	size_t i;
+	int isdue;
+
+	tick++;
+	for (i = 0; i < LEN(args); i++) {
+		isdue = due[i] <= t + period(i) / 8;
+		if (!all && !isdue && !wake[i])
+			continue;
+		wake[i] = 0;
+		at[i] = 0;
+		cur = i;
+		if (!(res = pflag ? profile(i) : args[i].func(args[i].args)))
+			res = unknown_str;
+		if (esnprintf(blocks[i], sizeof(blocks[i]), args[i].fmt, res) < 0)
+			blocks[i][0] = '\0';
+		/* skip the deadlines missed, e.g. while suspended */
+		if (at[i])
+			due[i] = at[i];
+		else if (isdue)
+			due[i] += (t + period(i) / 8 - due[i]) / period(i) * period(i)
+			          + period(i);
+	}
+}
+
+static uintmax_t
+nextdue(void)
+{
+	uintmax_t next = UINTMAX_MAX;
+	size_t i;
+
+	for (i = 0; i < LEN(args); i++)
+		if (due[i] < next)
+			next = due[i];
+
+	return next;
+}
+
+/*
+ * Re-evaluate the calling component as soon as fd becomes readable,
+ * in addition to its interval. It has to consume what made fd readable.
+ * An fd that reports an error or hangs up is dropped and wakes it once,
+ * watching it again re-adds it: the component has to read it then and,
+ * unless that fails with EAGAIN, unwatchfd() and close it instead.
+ */
+int
+watchfd(int fd)
+{
+	struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+	size_t i;
+	int known = 0;
+
+	for (i = 0; i < nwatches; i++) {
+		if (watches[i].fd != fd)
+			continue;
+		if (watches[i].arg == cur)
+			return 0;
+		known = 1;
+	}
+	if (nwatches == LEN(watches)) {
+		warn("watchfd: Too many watched descriptors");
+		return -1;
+	}
+	if (!known && epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		warn("epoll_ctl:");
+		return -1;
+	}
+	watches[nwatches].fd = fd;
+	watches[nwatches++].arg = cur;
+
+	return 0;
 }
 
+/* to be called before closing a watched fd */
+void
+unwatchfd(int fd)
+{
+	size_t i;
+
+	for (i = 0; i < nwatches;) {
+		if (watches[i].fd == fd)
+			watches[i] = watches[--nwatches];
+		else
+			i++;
+	}
+	epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+/*
+ * Memory of the args[] entry being evaluated, zeroed on first use. Lets
+ * components compare with their previous call without getting mixed up
+ * when they are configured more than once.
+ */
+void *
+state(size_t size)
+{
+	if (!states[cur] && !(states[cur] = calloc(1, size)))
+		die("calloc:");
+
+	return states[cur];
+}
+
+/* results the calling component still waits for, slstatus -1 waits too */
+void
+pending(int n)
+{
+	npending += n;
+}
+
+/* the X connection, shared by all components; opened on demand with -s */
+Display *
+xdisplay(void)
+{
+	if (!dpy && !(dpy = XOpenDisplay(NULL)))
+		warn("XOpenDisplay: Failed to open display");
+
+	return dpy;
+}
+
+static void
+xkbnames(void)
+{
+	XkbDescRec *desc;
+	char *symbols;
+
+	if (!(desc = XkbAllocKeyboard())) {
+		warn("XkbAllocKeyboard: Failed to allocate keyboard");
+		return;
+	}
+	if (XkbGetNames(dpy, XkbSymbolsNameMask, desc)) {
+		warn("XkbGetNames: Failed to retrieve key symbols");
+	} else if (!(symbols = XGetAtomName(dpy, desc->names->symbols))) {
+		warn("XGetAtomName: Failed to get atom name");
+	} else {
+		esnprintf(xkbcache.symbols, sizeof(xkbcache.symbols), "%s",
+		          symbols);
+		XFree(symbols);
+	}
+	XkbFreeKeyboard(desc, XkbSymbolsNameMask, 1);
+}
+
+/*
+ * Keyboard layout group, symbols and LEDs. They are fetched once, then
+ * only changed by the events selected here, so the calling component is
+ * woken up by the X connection and asking costs no round trip.
+ */
+const struct xkb *
+xkb(void)
+{
+	XkbStateRec state;
+	XEvent ev;
+	XkbEvent *xev = (XkbEvent *)&ev;
+	int op, err, major = XkbMajorVersion, minor = XkbMinorVersion;
+
+	if (!xdisplay())
+		return NULL;
+
+	if (xkbevent < 0) {
+		if (!XkbQueryExtension(dpy, &op, &xkbevent, &err, &major,
+		                       &minor)) {
+			warn("XkbQueryExtension: Extension not available");
+			return NULL;
+		}
+		/* group changes only, not every modifier press */
+		XkbSelectEventDetails(dpy, XkbUseCoreKbd, XkbStateNotify,
+		                      XkbGroupStateMask, XkbGroupStateMask);
+		XkbSelectEventDetails(dpy, XkbUseCoreKbd, XkbNamesNotify,
+		                      XkbSymbolsNameMask, XkbSymbolsNameMask);
+		XkbSelectEventDetails(dpy, XkbUseCoreKbd,
+		                      XkbIndicatorStateNotify,
+		                      XkbAllIndicatorsMask,
+		                      XkbAllIndicatorsMask);
+		if (XkbGetState(dpy, XkbUseCoreKbd, &state))
+			warn("XkbGetState: Failed to retrieve keyboard state");
+		else
+			xkbcache.group = state.group;
+		XkbGetIndicatorState(dpy, XkbUseCoreKbd, &xkbcache.leds);
+		xkbnames();
+	}
+	watchfd(ConnectionNumber(dpy));
+
+	while (XPending(dpy)) {
+		XNextEvent(dpy, &ev);
+		if (ev.type != xkbevent)
+			continue;
+		switch (xev->any.xkb_type) {
+		case XkbStateNotify:
+			xkbcache.group = xev->state.group;
+			break;
+		case XkbIndicatorStateNotify:
+			xkbcache.leds = xev->indicators.state;
+			break;
+		case XkbNamesNotify:
+			xkbnames();
+			break;
+		}
+	}
+
+	return &xkbcache;
+}
+
+/*
+ * A timer on the wall clock that is cancelled when the clock is set,
+ * e.g. by NTP or the user, so everything can be brought up to date.
+ */
 static void
-difftimespec(struct timespec *res, struct timespec *a, struct timespec *b)
+armclock(void)
 {
-	res->tv_sec = a->tv_sec - b->tv_sec - (a->tv_nsec < b->tv_nsec);
-	res->tv_nsec = a->tv_nsec - b->tv_nsec +
-	               (a->tv_nsec < b->tv_nsec) * 1E9;
+	struct itimerspec its = { 0 };
+
+	its.it_value.tv_sec = wallnow() / 1000 + 365 * 24 * 60 * 60;
+	if (timerfd_settime(clockfd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET,
+	                    &its, NULL) < 0)
+		warn("timerfd_settime:");
+}
+
+/* sleep until the next deadline, a signal or a watched fd */
+static void
+waitevents(void)
+{
+	struct epoll_event evs[16];
+	struct signalfd_siginfo si;
+	struct itimerspec its = { 0 };
+	uintmax_t next;
+	uint64_t expired;
+	size_t i;
+	int n, j;
+
+	next = nextdue();
+	its.it_value.tv_sec = next / 1000;
+	its.it_value.tv_nsec = next % 1000 * 1000000;
+	if (timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+		die("timerfd_settime:");
+
+	if ((n = epoll_wait(epfd, evs, LEN(evs), -1)) < 0) {
+		if (errno != EINTR)
+			die("epoll_wait:");
+		return;
+	}
+
+	for (j = 0; j < n; j++) {
+		if (evs[j].data.fd == sigfd) {
+			if (read(sigfd, &si, sizeof(si)) != sizeof(si))
+				continue;
+			if (si.ssi_signo == SIGUSR1)
+				refresh = 1;
+			else if (si.ssi_signo == SIGUSR2) {
+				if (pflag)
+					dumpprofile();
+			} else
+				done = 1;
+		} else if (evs[j].data.fd == tfd) {
+			if (read(tfd, &expired, sizeof(expired)) < 0 &&
+			    errno != EAGAIN)
+				die("read:");
+		} else if (evs[j].data.fd == clockfd) {
+			if (read(clockfd, &expired, sizeof(expired)) < 0 &&
+			    errno == ECANCELED)
+				refresh = 1;
+			armclock();
+		} else {
+			for (i = 0; i < nwatches; i++)
+				if (watches[i].fd == evs[j].data.fd)
+					wake[watches[i].arg] = 1;
+			/* nothing more to read, don't spin on it */
+			if (evs[j].events & (EPOLLERR | EPOLLHUP))
+				unwatchfd(evs[j].data.fd);
+		}
+	}
+}
+
+static void
+eventsinit(void)
+{
+	struct epoll_event ev = { .events = EPOLLIN };
+	sigset_t mask;
+
+	/* the handlers only matter while the signals are unblocked */
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGUSR1);
+	sigaddset(&mask, SIGUSR2);
+	if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0)
+		die("sigprocmask:");
+
+	if ((epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		die("epoll_create1:");
+	if ((sigfd = signalfd(-1, &mask, SFD_CLOEXEC)) < 0)
+		die("signalfd:");
+	if ((tfd = timerfd_create(CLOCK_BOOTTIME,
+	                          TFD_CLOEXEC | TFD_NONBLOCK)) < 0 ||
+	    (clockfd = timerfd_create(CLOCK_REALTIME,
+	                              TFD_CLOEXEC | TFD_NONBLOCK)) < 0)
+		die("timerfd_create:");
+	armclock();
+
+	ev.data.fd = sigfd;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, sigfd, &ev) < 0)
+		die("epoll_ctl:");
+	ev.data.fd = tfd;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev) < 0)
+		die("epoll_ctl:");
+	ev.data.fd = clockfd;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, clockfd, &ev) < 0)
+		die("epoll_ctl:");
 }
 
 static void
 usage(void)
 {
-	die("usage: %s [-v] [-s] [-1]", argv0);
+	die("usage: %s [-v] [-p] [-r root] [-s] [-1]", argv0);
 }
 
 int
 main(int argc, char *argv[])
 {
 	struct sigaction act;
-	struct timespec start, current, diff, intspec, wait;
+	uintmax_t t;
 	size_t i, len;
-	int sflag, ret;
-	char status[MAXLEN];
-	const char *res;
+	int sflag, ret, all;
+	char status[MAXLEN], last[MAXLEN];
 
 	sflag = 0;
 	ARGBEGIN {
 	case 'v':
 		die("slstatus-"VERSION);
+	case 'p':
+		pflag = 1;
+		break;
+	case 'r':
+		sysroot = EARGF(usage());
+		break;
 	case '1':
-		done = 1;
+		once = 1;
 		/* FALLTHROUGH */
 	case 's':
 		sflag = 1;
@@ -78,54 +549,69 @@ main(int argc, char *argv[])
 	act.sa_flags |= SA_RESTART;
 	sigaction(SIGUSR1, &act, NULL);
 
-	if (!sflag && !(dpy = XOpenDisplay(NULL)))
+	if (!sflag && !xdisplay())
 		die("XOpenDisplay: Failed to open display");
 
-	do {
-		if (clock_gettime(CLOCK_MONOTONIC, &start) < 0)
-			die("clock_gettime:");
+	if (pflag && (iofd = open("/proc/self/io", O_RDONLY | O_CLOEXEC)) < 0)
+		warn("open '/proc/self/io':");
+
+	eventsinit();
+
+	/* in step with the seconds of the wall clock, so components share
+	 * their wakeups with the clock */
+	t = now() - wallnow() % 1000;
+	for (i = 0; i < LEN(args); i++)
+		due[i] = t;
+
+	last[0] = '\0';
+	for (all = 1;; all = 0) {
+		if (refresh)
+			all = 1;
+		refresh = 0;
+		update(now(), all);
+		if (once && npending && !done) {
+			waitevents();
+			continue;
+		}
 
 		status[0] = '\0';
 		for (i = len = 0; i < LEN(args); i++) {
-			if (!(res = args[i].func(args[i].args)))
-				res = unknown_str;
-
 			if ((ret = esnprintf(status + len, sizeof(status) - len,
-			                     args[i].fmt, res)) < 0)
+			                     "%s", blocks[i])) < 0)
 				break;
 
 			len += ret;
 		}
 
-		if (sflag) {
-			puts(status);
-			fflush(stdout);
-			if (ferror(stdout))
-				die("puts:");
-		} else {
-			if (XStoreName(dpy, DefaultRootWindow(dpy), status) < 0)
-				die("XStoreName: Allocation failed");
-			XFlush(dpy);
+		/* only tell dwm when something changed, or when asked to */
+		if (all || once || strcmp(status, last)) {
+			if (sflag) {
+				puts(status);
+				fflush(stdout);
+				if (ferror(stdout))
+					die("puts:");
+			} else {
+				if (XStoreName(dpy, DefaultRootWindow(dpy),
+				               status) < 0)
+					die("XStoreName: Allocation failed");
+				XFlush(dpy);
+			}
+			memcpy(last, status, sizeof(last));
 		}
 
-		if (!done) {
-			if (clock_gettime(CLOCK_MONOTONIC, &current) < 0)
-				die("clock_gettime:");
-			difftimespec(&diff, &current, &start);
-
-			intspec.tv_sec = interval / 1000;
-			intspec.tv_nsec = (interval % 1000) * 1E6;
-			difftimespec(&wait, &intspec, &diff);
+		if (done || once)
+			break;
+		waitevents();
+		if (done)
+			break;
+	}
 
-			if (wait.tv_sec >= 0 &&
-			    nanosleep(&wait, NULL) < 0 &&
-			    errno != EINTR)
-					die("nanosleep:");
-		}
-	} while (!done);
+	if (pflag)
+		dumpprofile();
 
-	if (!sflag) {
-		XStoreName(dpy, DefaultRootWindow(dpy), NULL);
+	if (dpy) {
+		if (!sflag)
+			XStoreName(dpy, DefaultRootWindow(dpy), NULL);
 		if (XCloseDisplay(dpy) < 0)
 			die("XCloseDisplay: Failed to close display");
 	}
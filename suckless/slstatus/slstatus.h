@@ -1,5 +1,17 @@
 /* See LICENSE file for copyright and license details. */
 
+/* main loop */
+struct xkb {
+	int group;
+	unsigned int leds;
+	char symbols[256];
+};
+
+int watchfd(int fd);
+void unwatchfd(int fd);
+void pending(int n);
+const struct xkb *xkb(void);
+
 /* battery */
 const char *battery_perc(const char *);
 const char *battery_remaining(const char *);
@@ -10,7 +22,7 @@ const char *cat(const char *path);
 
 /* cpu */
 const char *cpu_freq(const char *unused);
-const char *cpu_perc(const char *unused);
+const char *cpu_perc(const char *cpu);
 
 /* datetime */
 const char *datetime(const char *fmt);
@@ -0,0 +1,29 @@
+/* See LICENSE file for copyright and license details. */
+
+/* components read from the fixture tree in root/, see `make test'. Those
+ * comparing with their previous call, like cpu_perc, can't be tested on it. */
+
+/* short, so that `make bench' sees many updates */
+const unsigned int interval = 10;
+const unsigned int cmdtimeout = 1000;
+static const char unknown_str[] = "n/a";
+
+#define MAXLEN 2048
+
+static const struct arg args[] = {
+	/* function          format         argument                                 interval */
+	{ cpu_freq,          "cpu %sHz",    NULL,                                    0 },
+	{ ram_perc,          " ram %s%%",   NULL,                                    0 },
+	{ ram_used,          " %s",         NULL,                                    0 },
+	{ ram_free,          "/%s",         NULL,                                    0 },
+	{ ram_total,         "/%s",         NULL,                                    0 },
+	{ swap_perc,         " swap %s%%",  NULL,                                    0 },
+	{ swap_used,         " %s",         NULL,                                    0 },
+	{ swap_free,         "/%s",         NULL,                                    0 },
+	{ swap_total,        "/%s",         NULL,                                    0 },
+	{ battery_perc,      " bat %s%%",   "BAT0",                                  0 },
+	{ battery_state,     " %s",         "BAT0",                                  0 },
+	{ battery_remaining, " %s",         "BAT0",                                  0 },
+	{ temp,              " %s C",       "/sys/class/thermal/thermal_zone0/temp", 0 },
+	{ entropy,           " entropy %s", NULL,                                    0 },
+};
@@ -1,14 +1,18 @@
 /* See LICENSE file for copyright and license details. */
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "util.h"
 
 char *argv0;
+const char *sysroot;
 
 static void
 verr(const char *fmt, va_list ap)
@@ -121,6 +125,20 @@ fmt_human(uintmax_t num, int base)
 	return bprintf("%.1f %s", scaled, prefix[i]);
 }
 
+/* /proc and /sys paths below sysroot, to run against a copy of them */
+const char *
+syspath(const char *path)
+{
+	static char p[PATH_MAX];
+
+	if (!sysroot || (strncmp(path, "/proc/", 6) && strncmp(path, "/sys/", 5)))
+		return path;
+	if (esnprintf(p, sizeof(p), "%s%s", sysroot, path) < 0)
+		return path;
+
+	return p;
+}
+
 int
 pscanf(const char *path, const char *fmt, ...)
 {
@@ -128,7 +146,7 @@ pscanf(const char *path, const char *fmt, ...)
 	va_list ap;
 	int n;
 
-	if (!(fp = fopen(path, "r"))) {
+	if (!(fp = fopen(syspath(path), "r"))) {
 		warn("fopen '%s':", path);
 		return -1;
 	}
@@ -139,3 +157,217 @@ pscanf(const char *path, const char *fmt, ...)
 
 	return (n == EOF) ? -1 : n;
 }
+
+/*
+ * Kernel files (/proc, /sys) are kept open and read again from offset 0,
+ * which gives fresh contents without an open/close per update. The
+ * buffer grows until the whole file fits, up to KMAX. Within one tick
+ * a file is read only once. Past LEN(kfiles) files, one spare entry is
+ * opened again for every file that is not the one it has; what it
+ * returns is only good until the next kread().
+ */
+#define KMAX (64 * 1024)
+
+static struct kfile {
+	char *path;
+	int fd;
+	char *buf;
+	size_t size;
+	unsigned int tick;
+} kfiles[32], spare;
+
+const char *
+kread(const char *path)
+{
+	static int full;
+	struct kfile *k, *slot = NULL;
+	ssize_t n;
+	size_t i;
+
+	for (i = 0, k = NULL; i < LEN(kfiles) && !k; i++) {
+		if (kfiles[i].path && !strcmp(kfiles[i].path, path))
+			k = &kfiles[i];
+		else if (!kfiles[i].path && !slot)
+			slot = &kfiles[i];
+	}
+	if (!k && !slot) {
+		if (!full) {
+			warn("kread: More than %zu files, '%s' and later ones "
+			     "are not kept open", LEN(kfiles), path);
+			full = 1;
+		}
+		if (spare.path && !strcmp(spare.path, path)) {
+			k = &spare;
+		} else {
+			if (spare.path) {
+				close(spare.fd);
+				free(spare.path);
+				spare.path = NULL;
+			}
+			slot = &spare;
+		}
+	}
+	if (!k) {
+		k = slot;
+		if ((k->fd = open(syspath(path), O_RDONLY | O_CLOEXEC)) < 0) {
+			warn("open '%s':", path);
+			return NULL;
+		}
+		if (!(k->path = strdup(path)))
+			die("strdup:");
+		if (!k->buf && !(k->buf = malloc(k->size = 4096)))
+			die("malloc:");
+	} else if (k->tick == tick) {
+		return k->buf;
+	}
+
+	while ((n = pread(k->fd, k->buf, k->size - 1, 0)) ==
+	       (ssize_t)k->size - 1 && k->size < KMAX) {
+		if (!(k->buf = realloc(k->buf, k->size *= 2)))
+			die("realloc:");
+	}
+	if (n < 0) {
+		/* e.g. the device is gone, open it again next time */
+		warn("pread '%s':", path);
+		close(k->fd);
+		free(k->path);
+		k->path = NULL;
+		return NULL;
+	}
+	k->buf[n] = '\0';
+	k->tick = tick;
+
+	return k->buf;
+}
+
+/* parse an unsigned decimal after blanks, return the rest or NULL */
+const char *
+kscanu(const char *s, uintmax_t *num)
+{
+	if (!s)
+		return NULL;
+	while (*s == ' ' || *s == '\t')
+		s++;
+	if (*s < '0' || *s > '9')
+		return NULL;
+	for (*num = 0; *s >= '0' && *s <= '9'; s++)
+		*num = *num * 10 + (*s - '0');
+
+	return s;
+}
+
+/* the rest of the line starting with key, e.g. "MemFree:" */
+const char *
+kfield(const char *s, const char *key)
+{
+	size_t len = strlen(key);
+
+	while (s) {
+		if (!strncmp(s, key, len))
+			return s + len;
+		if ((s = strchr(s, '\n')))
+			s++;
+	}
+
+	return NULL;
+}
+
+int
+kreadu(const char *path, uintmax_t *num)
+{
+	return kscanu(kread(path), num) ? 0 : -1;
+}
+
+/* /proc/meminfo, parsed once per tick */
+const struct meminfo *
+meminfo(void)
+{
+	static struct meminfo m;
+	static unsigned int when;
+	static int ok;
+	struct {
+		const char *name;
+		uintmax_t *var;
+	} ent[] = {
+		{ "MemTotal:",     &m.total     },
+		{ "MemFree:",      &m.free      },
+		{ "MemAvailable:", &m.available },
+		{ "Buffers:",      &m.buffers   },
+		{ "Cached:",       &m.cached    },
+		{ "SwapCached:",   &m.swapcached },
+		{ "SwapTotal:",    &m.swaptotal },
+		{ "SwapFree:",     &m.swapfree  },
+	};
+	const char *s;
+	size_t i;
+	unsigned int found, all = (1 << LEN(ent)) - 1;
+
+	if (when == tick)
+		return ok ? &m : NULL;
+	when = tick;
+	ok = 0;
+
+	if (!(s = kread("/proc/meminfo")))
+		return NULL;
+	for (found = 0; s && found != all; s = strchr(s, '\n')) {
+		if (*s == '\n')
+			s++;
+		for (i = 0; i < LEN(ent); i++) {
+			if (strncmp(s, ent[i].name, strlen(ent[i].name)))
+				continue;
+			if (kscanu(s + strlen(ent[i].name), ent[i].var))
+				found |= 1U << i;
+			break;
+		}
+	}
+	for (i = 0; i < LEN(ent); i++) {
+		if (!(found & (1U << i))) {
+			warn("'/proc/meminfo': No %s field", ent[i].name);
+			return NULL;
+		}
+	}
+	ok = 1;
+
+	return &m;
+}
+
+/* the cpu lines of /proc/stat, parsed once per tick */
+const struct procstat *
+procstat(void)
+{
+	static struct procstat p;
+	static unsigned int when;
+	static int ok;
+	const char *s;
+	uintmax_t n;
+	size_t i;
+
+	if (when == tick)
+		return ok ? &p : NULL;
+	when = tick;
+	ok = 0;
+
+	if (!(s = kread("/proc/stat")))
+		return NULL;
+	/* "cpu" for the sum of all cores, then "cpu0", "cpu1", ... */
+	for (p.ncpus = 0; !strncmp(s, "cpu", 3); s++) {
+		if (s[3] == ' ') {
+			n = 0;
+			s += 3;
+		} else if ((s = kscanu(s + 3, &n)) && n < MAXCPUS) {
+			n++;
+			if (n > p.ncpus)
+				p.ncpus = n;
+		} else {
+			break;
+		}
+		for (i = 0; i < LEN(p.cpu[n]); i++)
+			if (!(s = kscanu(s, &p.cpu[n][i])))
+				return NULL;
+		if (!(s = strchr(s, '\n')))
+			break;
+	}
+	ok = 1;
+
+	return &p;
+}
@@ -4,8 +4,10 @@
 extern char buf[1024];
 
 #define LEN(x) (sizeof(x) / sizeof((x)[0]))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
 
 extern char *argv0;
+extern const char *sysroot;
 
 void warn(const char *, ...);
 void die(const char *, ...);
@@ -13,4 +15,33 @@ void die(const char *, ...);
 int esnprintf(char *str, size_t size, const char *fmt, ...);
 const char *bprintf(const char *fmt, ...);
 const char *fmt_human(uintmax_t num, int base);
+const char *syspath(const char *path);
 int pscanf(const char *path, const char *fmt, ...);
+
+/* provided by slstatus.c */
+extern unsigned int tick; /* advanced once per update */
+uintmax_t now(void);      /* CLOCK_BOOTTIME, counts suspend, in ms */
+void wakeat(uintmax_t t);
+void *state(size_t size);
+
+const char *kread(const char *path);
+const char *kscanu(const char *s, uintmax_t *num);
+const char *kfield(const char *s, const char *key);
+int kreadu(const char *path, uintmax_t *num);
+
+struct meminfo {
+	uintmax_t total, free, available, buffers, cached; /* in KiB */
+	uintmax_t swapcached, swaptotal, swapfree;
+};
+
+#define MAXCPUS 256
+
+struct procstat {
+	size_t ncpus;
+	/* [0] is the sum of all cores, [1 + n] core n; in clock ticks:
+	 * user nice system idle iowait irq softirq */
+	uintmax_t cpu[MAXCPUS + 1][7];
+};
+
+const struct meminfo *meminfo(void);
+const struct procstat *procstat(void);
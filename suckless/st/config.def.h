@@ -46,6 +46,12 @@ int allowwindowops = 0;
 static double minlatency = 2;
 static double maxlatency = 33;
 
+/*
+ * Synchronized-Update timeout in ms
+ * https://gist.github.com/christianparpart/d8a62cc1ab659194337d73e399004036
+ */
+static uint synctimeout = 200;
+
 /*
  * blinking timeout (set to 0 to disable blinking) for the terminal blinking
  * attribute.
@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+# See LICENSE for license details.
+#
+# Generate width.h, the column width table used by st instead of
+# wcwidth(3). The data comes from the unicodedata module, which is
+# pinned to UNICODE below; regenerate with a matching Python:
+#
+#	./mkwidth.py > width.h
+#
+# `make test' checks runewidth() in width.h against this script's data.
+#
+# Widths follow glibc's wcwidth() rules: 0 for combining marks, format
+# characters and Hangul medial/final jamo, 2 for East Asian Wide and
+# Fullwidth, -1 for controls, line and paragraph separators, surrogates,
+# noncharacters and unassigned code points, 1 otherwise. The one
+# difference: unassigned code points in the ranges EastAsianWidth.txt
+# reserves as wide are 2, so that ideographs added later line up.
+#
+# With -t the widths are printed as "first last width" ranges instead,
+# the reference data for widthtest.c.
+
+import sys
+import unicodedata
+
+UNICODE = "14.0.0"
+BLOCK = 256
+CODES = {0: 0, 1: 1, 2: 2, -1: 3}
+# format characters that are drawn, Prepended_Concatenation_Mark
+SPACINGCF = {0xad, 0x600, 0x601, 0x602, 0x603, 0x604, 0x605, 0x6dd, 0x70f,
+             0x890, 0x891, 0x8e2, 0x110bd, 0x110cd}
+# unassigned code points that default to W, see EastAsianWidth.txt;
+# unicodedata reports F for every unassigned code point
+RESERVEDWIDE = ((0x3400, 0x4dbf), (0x4e00, 0x9fff), (0xf900, 0xfaff),
+                (0x20000, 0x2fffd), (0x30000, 0x3fffd))
+# East Asian Ambiguous, but wide in glibc
+WIDE = ((0x3248, 0x324f), (0x4dc0, 0x4dff))
+
+
+def width(cp):
+	c = chr(cp)
+	cat = unicodedata.category(c)
+	eaw = unicodedata.east_asian_width(c)
+
+	if cp == 0:
+		return 0
+	if cat in ("Cc", "Cs", "Zl", "Zp") or (cp & 0xfffe) == 0xfffe or \
+	   0xfdd0 <= cp <= 0xfdef:
+		return -1
+	if cat == "Cn":
+		return 2 if any(lo <= cp <= hi for lo, hi in RESERVEDWIDE) else -1
+	if cat in ("Mn", "Me") or (cat == "Cf" and cp not in SPACINGCF):
+		return 0
+	if 0x1160 <= cp <= 0x11ff or 0xd7b0 <= cp <= 0xd7ff or cp == 0x200b:
+		return 0
+	if eaw in ("W", "F") or any(lo <= cp <= hi for lo, hi in WIDE):
+		return 2
+	return 1
+
+
+def ranges():
+	lo, w = 0, width(0)
+	for cp in range(1, 0x110000):
+		if width(cp) != w:
+			sys.stdout.write("%x %x %d\n" % (lo, cp - 1, w))
+			lo, w = cp, width(cp)
+	sys.stdout.write("%x %x %d\n" % (lo, 0x10ffff, w))
+
+
+def main():
+	if unicodedata.unidata_version != UNICODE:
+		sys.exit("mkwidth.py: need Unicode %s data, have %s" %
+		         (UNICODE, unicodedata.unidata_version))
+	if sys.argv[1:] == ["-t"]:
+		ranges()
+		return
+	if sys.argv[1:]:
+		sys.exit("usage: mkwidth.py [-t]")
+
+	blocks, index = [], []
+	seen = {}
+	for base in range(0, 0x110000, BLOCK):
+		packed = bytearray(BLOCK // 4)
+		for i in range(BLOCK):
+			packed[i >> 2] |= CODES[width(base + i)] << ((i & 3) * 2)
+		packed = bytes(packed)
+		if packed not in seen:
+			seen[packed] = len(blocks)
+			blocks.append(packed)
+		index.append(seen[packed])
+	if len(blocks) > 256:
+		sys.exit("mkwidth.py: too many blocks for an uchar index")
+
+	out = sys.stdout
+	out.write("/* Generated by mkwidth.py from Unicode %s, do not edit. */\n\n"
+	          % UNICODE)
+	out.write("#define WIDTH_UNICODE \"%s\"\n\n" % UNICODE)
+	out.write("/* block of each 256 code points */\n")
+	out.write("static const uchar widthidx[%d] = {\n" % len(index))
+	for i in range(0, len(index), 16):
+		out.write("\t" + " ".join("%d," % x for x in index[i:i + 16]) + "\n")
+	out.write("};\n\n")
+	out.write("/* 2 bits per code point: 0, 1, 2 columns or 3 for -1 */\n")
+	out.write("static const uchar widthblk[%d][%d] = {\n" %
+	          (len(blocks), BLOCK // 4))
+	for b in blocks:
+		out.write("\t{\n")
+		for i in range(0, len(b), 8):
+			out.write("\t\t" + " ".join("0x%02x," % x for x in b[i:i + 8]) + "\n")
+		out.write("\t},\n")
+	out.write("};\n\n")
+	out.write("""/* like wcwidth(3), but locale independent and from a fixed Unicode version */
+static int
+runewidth(Rune u)
+{
+	static const signed char w[] = { 0, 1, 2, -1 };
+
+	if (u > 0x10FFFF)
+		return -1;
+	return w[widthblk[widthidx[u >> 8]][(u & 0xFF) >> 2] >> ((u & 3) * 2) & 3];
+}
+""")
+
+
+if __name__ == "__main__":
+	main()
@@ -14,11 +14,13 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 #include <wchar.h>
 
 #include "st.h"
 #include "win.h"
+#include "width.h"
 
 #if   defined(__linux)
  #include <pty.h>
@@ -134,7 +136,10 @@ typedef struct {
 	int charset;  /* current charset */
 	int icharset; /* selected charset for sequence */
 	int *tabs;
+	TCursor sc[2]; /* saved cursors, normal and alternate screen */
 	Rune lastc;   /* last printed char outside of sequence, 0 if control */
+	int su;       /* synchronized update (mode 2026) in progress */
+	struct timespec sutv; /* synchronized update start time */
 } Term;
 
 /* CSI Escape sequence structs */
@@ -159,9 +164,23 @@ typedef struct {
 	int narg;              /* nb of args */
 } STREscape;
 
+/* Everything tsave() has to stash away for one terminal */
+typedef struct {
+	Term term;
+	Selection sel;
+	CSIEscape csiescseq;
+	STREscape strescseq;
+	int iofd;
+	int cmdfd;
+	pid_t pid;
+	char ttybuf[BUFSIZ];
+	int ttybuflen;
+} TermState;
+
 static void execsh(char *, char **);
 static void stty(char **);
 static void sigchld(int);
+static void ttyclose(void);
 static void ttywriteraw(const char *, size_t);
 
 static void csidump(void);
@@ -200,6 +219,7 @@ static void tsetdirt(int, int);
 static void tsetscroll(int, int);
 static void tswapscreen(void);
 static void tsetmode(int, int, const int *, int);
+static void tsync(int);
 static int twrite(const char *, int, int);
 static void tfulldirt(void);
 static void tcontrolcode(uchar );
@@ -233,6 +253,8 @@ static STREscape strescseq;
 static int iofd = 1;
 static int cmdfd;
 static pid_t pid;
+static char ttybuf[BUFSIZ];
+static int ttybuflen;
 
 static const uchar utfbyte[UTF_SIZ + 1] = {0x80,    0, 0xC0, 0xE0, 0xF0};
 static const uchar utfmask[UTF_SIZ + 1] = {0xC0, 0x80, 0xE0, 0xF0, 0xF8};
@@ -719,9 +741,21 @@ execsh(char *cmd, char **args)
 void
 sigchld(int a)
 {
-	int stat;
+	int stat, olderrno;
 	pid_t p;
 
+	/*
+	 * A server outlives its shells: reap whatever exited, the window
+	 * goes away once its tty hangs up.
+	 */
+	if (servermode) {
+		olderrno = errno;
+		while (waitpid(-1, NULL, WNOHANG) > 0)
+			;
+		errno = olderrno;
+		return;
+	}
+
 	if ((p = waitpid(pid, &stat, WNOHANG)) < 0)
 		die("waiting for pid %hd failed: %s\n", pid, strerror(errno));
 
@@ -760,7 +794,8 @@ stty(char **args)
 }
 
 int
-ttynew(const char *line, char *cmd, const char *out, char **args)
+ttynew(const char *line, char *cmd, const char *out, char **args,
+       const char *dir)
 {
 	int m, s;
 
@@ -802,6 +837,8 @@ ttynew(const char *line, char *cmd, const char *out, char **args)
 			die("ioctl TIOCSCTTY failed: %s\n", strerror(errno));
 		if (s > 2)
 			close(s);
+		if (dir && chdir(dir) < 0)
+			fprintf(stderr, "chdir %s: %s\n", dir, strerror(errno));
 #ifdef __OpenBSD__
 		if (pledge("stdio getpw proc exec", NULL) == -1)
 			die("pledge\n");
@@ -815,6 +852,8 @@ ttynew(const char *line, char *cmd, const char *out, char **args)
 #endif
 		close(s);
 		cmdfd = m;
+		/* keep other shells from inheriting this pty */
+		fcntl(cmdfd, F_SETFD, FD_CLOEXEC);
 		signal(SIGCHLD, sigchld);
 		break;
 	}
@@ -824,29 +863,44 @@ ttynew(const char *line, char *cmd, const char *out, char **args)
 size_t
 ttyread(void)
 {
-	static char buf[BUFSIZ];
-	static int buflen = 0;
 	int ret, written;
 
+	if (cmdfd < 0)
+		return 0;
+
 	/* append read bytes to unprocessed bytes */
-	ret = read(cmdfd, buf+buflen, LEN(buf)-buflen);
+	ret = read(cmdfd, ttybuf+ttybuflen, LEN(ttybuf)-ttybuflen);
 
 	switch (ret) {
 	case 0:
-		exit(0);
+		ttyclose();
+		return 0;
 	case -1:
+		/* linux reports a hung up slave side as EIO */
+		if (errno == EIO) {
+			ttyclose();
+			return 0;
+		}
 		die("couldn't read from shell: %s\n", strerror(errno));
 	default:
-		buflen += ret;
-		written = twrite(buf, buflen, 0);
-		buflen -= written;
+		ttybuflen += ret;
+		written = twrite(ttybuf, ttybuflen, 0);
+		ttybuflen -= written;
 		/* keep any incomplete UTF-8 byte sequence for the next call */
-		if (buflen > 0)
-			memmove(buf, buf + written, buflen);
+		if (ttybuflen > 0)
+			memmove(ttybuf, ttybuf + written, ttybuflen);
 		return ret;
 	}
 }
 
+void
+ttyclose(void)
+{
+	close(cmdfd);
+	cmdfd = -1;
+	xclose();
+}
+
 void
 ttywrite(const char *s, size_t n, int may_echo)
 {
@@ -891,7 +945,7 @@ ttywriteraw(const char *s, size_t n)
 	 * dance.
 	 * FIXME: Migrate the world to Plan 9.
 	 */
-	while (n > 0) {
+	while (n > 0 && cmdfd >= 0) {
 		FD_ZERO(&wfd);
 		FD_ZERO(&rfd);
 		FD_SET(cmdfd, &wfd);
@@ -932,6 +986,10 @@ ttywriteraw(const char *s, size_t n)
 	return;
 
 write_error:
+	if (errno == EIO) {
+		ttyclose();
+		return;
+	}
 	die("write error on tty: %s\n", strerror(errno));
 }
 
@@ -1006,14 +1064,13 @@ tfulldirt(void)
 void
 tcursor(int mode)
 {
-	static TCursor c[2];
 	int alt = IS_SET(MODE_ALTSCREEN);
 
 	if (mode == CURSOR_SAVE) {
-		c[alt] = term.c;
+		term.sc[alt] = term.c;
 	} else if (mode == CURSOR_LOAD) {
-		term.c = c[alt];
-		tmoveto(c[alt].x, c[alt].y);
+		term.c = term.sc[alt];
+		tmoveto(term.sc[alt].x, term.sc[alt].y);
 	}
 }
 
@@ -1036,6 +1093,7 @@ treset(void)
 	term.mode = MODE_WRAP|MODE_UTF8;
 	memset(term.trantbl, CS_USA, sizeof(term.trantbl));
 	term.charset = 0;
+	term.su = 0;
 
 	for (i = 0; i < 2; i++) {
 		tmoveto(0, 0);
@@ -1049,10 +1107,72 @@ void
 tnew(int col, int row)
 {
 	term = (Term){ .c = { .attr = { .fg = defaultfg, .bg = defaultbg } } };
+	csiescseq = (CSIEscape){0};
+	strescseq = (STREscape){0};
+	iofd = 1;
+	cmdfd = -1;
+	pid = 0;
+	ttybuflen = 0;
 	tresize(col, row);
 	treset();
 }
 
+void
+tfree(void)
+{
+	int i;
+
+	if (cmdfd >= 0)
+		close(cmdfd);
+	if (iofd > 2)
+		close(iofd);
+	for (i = 0; i < term.row; i++) {
+		free(term.line[i]);
+		free(term.alt[i]);
+	}
+	for (i = 0; i < HISTSIZE; i++)
+		free(term.hist[i]);
+	free(term.line);
+	free(term.alt);
+	free(term.dirty);
+	free(term.tabs);
+	free(strescseq.buf);
+}
+
+void *
+tsave(void *p)
+{
+	TermState *ts = p ? p : xmalloc(sizeof(*ts));
+
+	ts->term = term;
+	ts->sel = sel;
+	ts->csiescseq = csiescseq;
+	ts->strescseq = strescseq;
+	ts->iofd = iofd;
+	ts->cmdfd = cmdfd;
+	ts->pid = pid;
+	memcpy(ts->ttybuf, ttybuf, ttybuflen);
+	ts->ttybuflen = ttybuflen;
+
+	return ts;
+}
+
+void
+tload(const void *p)
+{
+	const TermState *ts = p;
+
+	term = ts->term;
+	sel = ts->sel;
+	csiescseq = ts->csiescseq;
+	strescseq = ts->strescseq;
+	iofd = ts->iofd;
+	cmdfd = ts->cmdfd;
+	pid = ts->pid;
+	memcpy(ttybuf, ts->ttybuf, ts->ttybuflen);
+	ttybuflen = ts->ttybuflen;
+}
+
 void
 tswapscreen(void)
 {
@@ -1528,6 +1648,29 @@ tsetscroll(int t, int b)
 	term.bot = b;
 }
 
+void
+tsync(int set)
+{
+	term.su = set;
+	if (set)
+		clock_gettime(CLOCK_MONOTONIC, &term.sutv);
+}
+
+int
+tinsync(uint timeout)
+{
+	struct timespec now;
+
+	/*
+	 * Never trust the application to close the update: a crashed or
+	 * killed program would otherwise freeze the window forever.
+	 */
+	if (term.su && !clock_gettime(CLOCK_MONOTONIC, &now)
+	            && TIMEDIFF(now, term.sutv) >= timeout)
+		term.su = 0;
+	return term.su;
+}
+
 void
 tsetmode(int priv, int set, const int *args, int narg)
 {
@@ -1616,6 +1759,9 @@ tsetmode(int priv, int set, const int *args, int narg)
 			case 2004: /* 2004: bracketed paste mode */
 				xsetmode(set, MODE_BRCKTPASTE);
 				break;
+			case 2026: /* 2026: synchronized update (BSU/ESU) */
+				tsync(set);
+				break;
 			/* Not implemented mouse modes. See comments there. */
 			case 1001: /* mouse highlight mode; can hang the
 				      terminal by design when implemented. */
@@ -2440,7 +2586,7 @@ tputc(Rune u)
 		width = len = 1;
 	} else {
 		len = utf8encode(u, c);
-		if (!control && (width = wcwidth(u)) == -1)
+		if (!control && (width = runewidth(u)) == -1)
 			width = 1;
 	}
 
@@ -20,6 +20,9 @@
 #define TRUECOLOR(r,g,b)	(1 << 24 | (r) << 16 | (g) << 8 | (b))
 #define IS_TRUECOL(x)		(1 << 24 & (x))
 
+/* st -d listens on, and stc connects to: runtime dir, uid, $DISPLAY */
+#define SOCKFMT			"%s/st-%d%s"
+
 enum glyph_attribute {
 	ATTR_NULL       = 0,
 	ATTR_BOLD       = 1 << 0,
@@ -89,11 +92,15 @@ void sendbreak(const Arg *);
 void toggleprinter(const Arg *);
 
 int tattrset(int);
+void tfree(void);
+int tinsync(uint);
+void tload(const void *);
 void tnew(int, int);
+void *tsave(void *);
 void tresize(int, int);
 void tsetdirtattr(int);
 void ttyhangup(void);
-int ttynew(const char *, char *, const char *, char **);
+int ttynew(const char *, char *, const char *, char **, const char *);
 size_t ttyread(void);
 void ttyresize(int, int);
 void ttywrite(const char *, size_t, int);
@@ -113,6 +120,9 @@ void *xmalloc(size_t);
 void *xrealloc(void *, size_t);
 char *xstrdup(const char *);
 
+/* x.c globals */
+extern int servermode;
+
 /* config.h globals */
 extern char *utmp;
 extern char *scroll;
@@ -0,0 +1,87 @@
+/* See LICENSE for license details. */
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "st.h"
+
+/*
+ * stc - open a window in a running `st -d', falling back to a plain st
+ * when there is none. The request is the working directory followed by
+ * the arguments, all NUL-terminated; the server answers with an error
+ * message or not at all.
+ */
+
+static ssize_t
+xwrite(int fd, const char *s, size_t len)
+{
+	size_t aux = len;
+	ssize_t r;
+
+	while (len > 0) {
+		if ((r = write(fd, s, len)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return r;
+		}
+		s += r;
+		len -= r;
+	}
+
+	return aux;
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	char buf[BUFSIZ], cwd[PATH_MAX], *dir, *disp;
+	ssize_t n;
+	int fd, i, err = 0;
+
+	if (!(dir = getenv("XDG_RUNTIME_DIR")))
+		dir = "/tmp";
+	if (!(disp = getenv("DISPLAY")))
+		disp = "";
+	snprintf(addr.sun_path, sizeof(addr.sun_path), SOCKFMT,
+	         dir, (int)getuid(), disp);
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+	    connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		argv[0] = "st";
+		execvp(argv[0], argv);
+		fprintf(stderr, "stc: execvp st: %s\n", strerror(errno));
+		return 1;
+	}
+
+	if (!getcwd(cwd, sizeof(cwd)))
+		cwd[0] = '\0';
+	if (xwrite(fd, cwd, strlen(cwd) + 1) < 0)
+		goto fail;
+	for (i = 1; i < argc; i++)
+		if (xwrite(fd, argv[i], strlen(argv[i]) + 1) < 0)
+			goto fail;
+	shutdown(fd, SHUT_WR);
+
+	while ((n = read(fd, buf, sizeof(buf))) != 0) {
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			goto fail;
+		}
+		fwrite(buf, 1, n, stderr);
+		err = 1;
+	}
+	close(fd);
+
+	return err;
+
+fail:
+	fprintf(stderr, "stc: %s: %s\n", addr.sun_path, strerror(errno));
+	return 1;
+}
@@ -0,0 +1,109 @@
+/* See LICENSE for license details. */
+#include <locale.h>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "st.h"
+#include "width.h"
+
+/*
+ * widthtest - check runewidth() for every code point against the
+ * reference data on stdin, the "first last width" lines (hex, hex,
+ * decimal) of mkwidth.py -t.
+ *
+ * widthtest -l checks it against wcwidth() of the C library in a UTF-8
+ * locale instead, which comes from the Unicode data on its own.
+ */
+
+/*
+ * Where st and glibc are known to differ: unassigned code points in the
+ * blocks and planes reserved for CJK ideographs are wide in st, as
+ * terminals and fonts will draw them once assigned, but -1 in glibc.
+ */
+static const struct {
+	Rune lo, hi;
+	int st, libc;
+} accepted[] = {
+	{ 0x3400,  0x4DBF,  2, -1 },
+	{ 0x4E00,  0x9FFF,  2, -1 },
+	{ 0xF900,  0xFAFF,  2, -1 },
+	{ 0x20000, 0x2FFFD, 2, -1 },
+	{ 0x30000, 0x3FFFD, 2, -1 },
+};
+
+static int
+libctest(void)
+{
+	unsigned long u, bad = 0;
+	size_t i;
+	int w, lw;
+
+	if (!setlocale(LC_CTYPE, "C.UTF-8") && !setlocale(LC_CTYPE, "en_US.UTF-8")) {
+		fprintf(stderr, "widthtest: no UTF-8 locale, skipped\n");
+		return 0;
+	}
+	/* U+1FAE0 is new in Unicode 14.0, U+1FAE8 in 15.0 */
+	if (wcwidth(0x1FAE0) != 2 || wcwidth(0x1FAE8) != -1) {
+		fprintf(stderr, "widthtest: the C library is not at Unicode %s, "
+		        "skipped\n", WIDTH_UNICODE);
+		return 0;
+	}
+	for (u = 0; u < 0x110000; u++) {
+		if ((w = runewidth(u)) == (lw = wcwidth(u)))
+			continue;
+		for (i = 0; i < LEN(accepted); i++)
+			if (BETWEEN(u, accepted[i].lo, accepted[i].hi) &&
+			    w == accepted[i].st && lw == accepted[i].libc)
+				break;
+		if (i < LEN(accepted))
+			continue;
+		if (bad++ < 16)
+			fprintf(stderr, "widthtest: U+%04lX is %d, wcwidth() %d\n",
+			        u, w, lw);
+	}
+	if (bad) {
+		fprintf(stderr, "widthtest: %lu code points differ from wcwidth()\n",
+		        bad);
+		return 1;
+	}
+
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned long lo, hi, u, next = 0, bad = 0;
+	int w;
+
+	if (argc > 1 && !strcmp(argv[1], "-l"))
+		return libctest();
+	while (scanf("%lx %lx %d", &lo, &hi, &w) == 3) {
+		if (lo != next || hi < lo) {
+			fprintf(stderr, "widthtest: bad range %lx %lx\n", lo, hi);
+			return 1;
+		}
+		for (u = lo; u <= hi; u++) {
+			if (runewidth(u) == w)
+				continue;
+			if (bad++ < 16)
+				fprintf(stderr, "widthtest: U+%04lX is %d, want %d\n",
+				        u, runewidth(u), w);
+		}
+		next = hi + 1;
+	}
+	if (next != 0x110000) {
+		fprintf(stderr, "widthtest: reference data ends at U+%04lX\n", next);
+		return 1;
+	}
+	/* beyond Unicode */
+	if (runewidth(0x110000) != -1 || runewidth(0xFFFFFFFF) != -1)
+		bad++;
+	if (bad) {
+		fprintf(stderr, "widthtest: %lu code points wrong\n", bad);
+		return 1;
+	}
+
+	return 0;
+}
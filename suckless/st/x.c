@@ -1,15 +1,20 @@
 /* See LICENSE for license details. */
 #include <errno.h>
+#include <fcntl.h>
 #include <math.h>
 #include <limits.h>
 #include <locale.h>
 #include <signal.h>
 #include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <time.h>
 #include <unistd.h>
 #include <libgen.h>
 #include <X11/Xatom.h>
 #include <X11/Xlib.h>
+#include <X11/Xproto.h>
 #include <X11/cursorfont.h>
 #include <X11/keysym.h>
 #include <X11/Xft/Xft.h>
@@ -67,6 +72,13 @@ static void ttysend(const Arg *);
 #define XEMBED_FOCUS_IN  4
 #define XEMBED_FOCUS_OUT 5
 
+/* limits on stc requests, in bytes and milliseconds */
+#define REQMAX     (64 * 1024)
+#define REQTIMEOUT 5000
+
+/* an INCR requestor not taking a chunk for that long is given up on */
+#define INCRTIMEOUT 10000
+
 /* macros */
 #define IS_SET(flag)		((win.mode & (flag)) != 0)
 #define TRUERED(x)		(((x) & 0xff0000) >> 8)
@@ -114,10 +126,32 @@ typedef struct {
 typedef struct {
 	Atom xtarget;
 	char *primary, *clipboard;
+	int incr; /* receiving INCR: 1 announced, 2 data flowing */
 	struct timespec tclick1;
 	struct timespec tclick2;
 } XSelection;
 
+/* outgoing INCR transfer, ICCCM 2.7.2 */
+typedef struct Incr {
+	Window requestor;
+	Atom property, target;
+	char *data;
+	size_t len, ofs;
+	int own; /* data was copied when the selection changed */
+	int dead; /* requestor went away, see xerror() */
+	struct timespec last; /* when the last chunk was taken */
+	struct Incr *next;
+} Incr;
+
+/* stc request still being read */
+typedef struct Req {
+	int fd;
+	char *buf;
+	size_t len, siz;
+	struct timespec start;
+	struct Req *next;
+} Req;
+
 /* Font structure */
 #define Font Font_
 typedef struct {
@@ -134,6 +168,22 @@ typedef struct {
 	FcPattern *pattern;
 } Font;
 
+/* Font Ring Cache */
+enum {
+	FRC_NORMAL,
+	FRC_ITALIC,
+	FRC_BOLD,
+	FRC_ITALICBOLD
+};
+
+typedef struct {
+	XftFont *font;
+	FcPattern *pattern; /* spare font, not opened before first use */
+	int matched;        /* pattern is the match, not the query */
+	int flags;
+	Rune unicodep;
+} Fontcache;
+
 /* Drawing Context */
 typedef struct {
 	Color *col;
@@ -142,6 +192,38 @@ typedef struct {
 	GC gc;
 } DC;
 
+/*
+ * A terminal window. A server (st -d) drives many of them over one X
+ * connection with one set of fonts and colors; the per-window globals
+ * are swapped in and out by wswitch().
+ */
+typedef struct Win Win;
+struct Win {
+	XWindow xw;
+	TermWindow win;
+	XSelection xsel;
+	uint buttons;
+	char *opt_class;
+	char **opt_cmd;
+	char *opt_embed;
+	char *opt_io;
+	char *opt_line;
+	char *opt_name;
+	char *opt_title;
+	char *cwd;      /* working directory of the shell */
+	char *req;      /* stc request the strings above point into */
+	char **reqv;
+	void *term;     /* st.c state while switched out, see tsave() */
+	int ttyfd;      /* -1 until the window is mapped */
+	int closed;
+	int ev;         /* tty input or X events since the last pass */
+	int syncing;    /* synchronized update open before the tty read */
+	int drawing;
+	double timeout;
+	struct timespec tv, trigger, lastblink;
+	Win *next;
+};
+
 static inline ushort sixd_to_16bit(int);
 static int xmakeglyphfontspecs(XftGlyphFontSpec *, const Glyph *, int, int, int);
 static void xdrawglyphfontspecs(const XftGlyphFontSpec *, Glyph, int, int, int);
@@ -152,15 +234,21 @@ static int ximopen(Display *);
 static void ximinstantiate(Display *, XPointer, XPointer);
 static void ximdestroy(XIM, XPointer, XPointer);
 static int xicdestroy(XIC, XPointer, XPointer);
-static void xinit(int, int);
+static void xinit(void);
+static void xcreate(int, int);
 static void cresize(int, int);
 static void xresize(int, int);
 static void xhints(void);
 static int xloadcolor(int, const char *, Color *);
 static int xloadfont(Font *, FcPattern *);
 static void xloadfonts(const char *, double);
-static int xloadsparefont(FcPattern *, int);
+static void xloadsparefont(FcPattern *, int);
+static int xopensparefont(Fontcache *, Rune);
 static void xloadsparefonts(void);
+static char *fallbackpath(void);
+static unsigned long fallbackstamp(void);
+static int fallbackfind(Font *, int, Rune);
+static void fallbackadd(FcPattern *, int, Rune);
 static void xunloadfont(Font *);
 static void xunloadfonts(void);
 static void xsetenv(void);
@@ -168,6 +256,20 @@ static void xseturgency(int);
 static int evcol(XEvent *);
 static int evrow(XEvent *);
 
+static Win *wnew(void);
+static void wfree(Win *);
+static Win *wfind(Window);
+static void wload(Win *);
+static void wreset(void);
+static void wsave(Win *);
+static void wswitch(Win *);
+static void wdraw(Win *, struct timespec);
+static void srvinit(void);
+static void srvaccept(void);
+static int srvread(Req *);
+static void srvrequest(Req *);
+static void srvdrop(Req *, const char *);
+
 static void expose(XEvent *);
 static void visibility(XEvent *);
 static void unmap(XEvent *);
@@ -185,11 +287,18 @@ static void selnotify(XEvent *);
 static void selclear_(XEvent *);
 static void selrequest(XEvent *);
 static void setsel(char *, Time);
+static void selfree(char *);
+static size_t selchunk(void);
+static int incrnotify(XEvent *);
+static void incrselect(Incr *);
+static void incrdrop(Incr **);
+static int xerror(Display *, XErrorEvent *);
 static void mousesel(XEvent *, int);
 static void mousereport(XEvent *);
 static char *kmap(KeySym, uint);
 static int match(uint, uint);
 
+static int parseargs(int, char *[], int);
 static void run(void);
 static void usage(void);
 
@@ -225,24 +334,26 @@ static XWindow xw;
 static XSelection xsel;
 static TermWindow win;
 
-/* Font Ring Cache */
-enum {
-	FRC_NORMAL,
-	FRC_ITALIC,
-	FRC_BOLD,
-	FRC_ITALICBOLD
-};
-
-typedef struct {
-	XftFont *font;
-	int flags;
-	Rune unicodep;
-} Fontcache;
-
 /* Fontcache is an array now. A new font will be appended to the array. */
 static Fontcache *frc = NULL;
 static int frclen = 0;
 static int frccap = 0;
+
+/* fallback fonts found in earlier runs, see fallbackfind() */
+#define FBCMAX 1024 /* entries in the file */
+
+typedef struct {
+	Rune lo, hi;
+	int flags;
+	int index;
+	char *file;
+} Fallback;
+
+static Fallback *fbc = NULL;
+static int fbclen = -1; /* not read yet */
+static int fbcstale = 1; /* file needs a new header */
+static int fbcfile = 0;  /* entries in the file */
+static char fbchdr[256];  /* header of a valid file, see fallbackfind() */
 static char *usedfont = NULL;
 static double usedfontsize = 0;
 static double defaultfontsize = 0;
@@ -258,12 +369,22 @@ static char *opt_title = NULL;
 
 static uint buttons; /* bit field of pressed buttons */
 
+static Incr *incrs;
+static int (*xerrorxlib)(Display *, XErrorEvent *);
+
+static Win *wins, *selwin;
+static struct sockaddr_un srvaddr = { .sun_family = AF_UNIX };
+static int srvfd = -1;
+static Req *reqs;
+static uint defcols, defrows;
+int servermode = 0;
+
 void
 clipcopy(const Arg *dummy)
 {
 	Atom clipboard;
 
-	free(xsel.clipboard);
+	selfree(xsel.clipboard);
 	xsel.clipboard = NULL;
 
 	if (xsel.primary != NULL) {
@@ -308,12 +429,27 @@ zoom(const Arg *arg)
 void
 zoomabs(const Arg *arg)
 {
+	Win *w, *sw = selwin;
+	int cw, ch;
+
 	xunloadfonts();
 	xloadfonts(usedfont, arg->f);
 	xloadsparefonts();
-	cresize(0, 0);
-	redraw();
-	xhints();
+
+	/* fonts are shared by all windows, so is the cell size */
+	cw = win.cw;
+	ch = win.ch;
+	for (w = wins; w; w = w->next) {
+		wswitch(w);
+		win.cw = cw;
+		win.ch = ch;
+		if (w->ttyfd < 0)
+			continue;
+		cresize(0, 0);
+		redraw();
+		xhints();
+	}
+	wswitch(sw);
 }
 
 void
@@ -514,6 +650,9 @@ propnotify(XEvent *e)
 	XPropertyEvent *xpev;
 	Atom clipboard = XInternAtom(xw.dpy, "CLIPBOARD", 0);
 
+	if (incrnotify(e))
+		return;
+
 	xpev = &e->xproperty;
 	if (xpev->state == PropertyNewValue &&
 			(xpev->atom == XA_PRIMARY ||
@@ -533,9 +672,13 @@ selnotify(XEvent *e)
 	incratom = XInternAtom(xw.dpy, "INCR", 0);
 
 	ofs = 0;
-	if (e->type == SelectionNotify)
+	if (e->type == SelectionNotify) {
+		/* a new paste, an INCR one before it was abandoned */
+		if (IS_SET(MODE_BRCKTPASTE) && xsel.incr == 2)
+			ttywrite("\033[201~", 6, 0);
+		xsel.incr = 0;
 		property = e->xselection.property;
-	else if (e->type == PropertyNotify)
+	} else if (e->type == PropertyNotify)
 		property = e->xproperty.atom;
 
 	if (property == None)
@@ -543,7 +686,7 @@ selnotify(XEvent *e)
 
 	do {
 		if (XGetWindowProperty(xw.dpy, xw.win, property, ofs,
-					BUFSIZ/4, False, AnyPropertyType,
+					selchunk()/4, False, AnyPropertyType,
 					&type, &format, &nitems, &rem,
 					&data)) {
 			fprintf(stderr, "Clipboard allocation failed\n");
@@ -560,6 +703,11 @@ selnotify(XEvent *e)
 			MODBIT(xw.attrs.event_mask, 0, PropertyChangeMask);
 			XChangeWindowAttributes(xw.dpy, xw.win, CWEventMask,
 					&xw.attrs);
+			if (IS_SET(MODE_BRCKTPASTE) && xsel.incr == 2)
+				ttywrite("\033[201~", 6, 0);
+			xsel.incr = 0;
+			XFree(data);
+			break;
 		}
 
 		if (type == incratom) {
@@ -575,6 +723,8 @@ selnotify(XEvent *e)
 			/*
 			 * Deleting the property is the transfer start signal.
 			 */
+			xsel.incr = 1;
+			XFree(data);
 			XDeleteProperty(xw.dpy, xw.win, (int)property);
 			continue;
 		}
@@ -592,10 +742,13 @@ selnotify(XEvent *e)
 			*repl++ = '\r';
 		}
 
-		if (IS_SET(MODE_BRCKTPASTE) && ofs == 0)
+		/* an INCR paste is bracketed as a whole */
+		if (IS_SET(MODE_BRCKTPASTE) && ofs == 0 && xsel.incr != 2)
 			ttywrite("\033[200~", 6, 0);
+		if (xsel.incr)
+			xsel.incr = 2;
 		ttywrite((char *)data, nitems * format / 8, 1);
-		if (IS_SET(MODE_BRCKTPASTE) && rem == 0)
+		if (IS_SET(MODE_BRCKTPASTE) && rem == 0 && !xsel.incr)
 			ttywrite("\033[201~", 6, 0);
 		XFree(data);
 		/* number of 32-bit chunks returned */
@@ -628,6 +781,8 @@ selrequest(XEvent *e)
 	XSelectionEvent xev;
 	Atom xa_targets, string, clipboard;
 	char *seltext;
+	Incr *incr;
+	ulong len;
 
 	xsre = (XSelectionRequestEvent *) e;
 	xev.type = SelectionNotify;
@@ -665,11 +820,25 @@ selrequest(XEvent *e)
 				xsre->selection);
 			return;
 		}
-		if (seltext != NULL) {
+		if (seltext != NULL && (len = strlen(seltext)) > selchunk()) {
+			/* too big for one request, hand it out in chunks */
+			incr = xmalloc(sizeof(*incr));
+			*incr = (Incr){ xsre->requestor, xsre->property,
+			                xsre->target, seltext, len, 0, 0, 0,
+			                { 0 }, incrs };
+			clock_gettime(CLOCK_MONOTONIC, &incr->last);
+			incrs = incr;
+			incrselect(incr);
+			XChangeProperty(xsre->display, xsre->requestor,
+					xsre->property,
+					XInternAtom(xw.dpy, "INCR", 0),
+					32, PropModeReplace, (uchar *)&len, 1);
+			xev.property = xsre->property;
+		} else if (seltext != NULL) {
 			XChangeProperty(xsre->display, xsre->requestor,
 					xsre->property, xsre->target,
 					8, PropModeReplace,
-					(uchar *)seltext, strlen(seltext));
+					(uchar *)seltext, len);
 			xev.property = xsre->property;
 		}
 	}
@@ -685,7 +854,7 @@ setsel(char *str, Time t)
 	if (!str)
 		return;
 
-	free(xsel.primary);
+	selfree(xsel.primary);
 	xsel.primary = str;
 
 	XSetSelectionOwner(xw.dpy, XA_PRIMARY, xw.win, t);
@@ -694,6 +863,135 @@ setsel(char *str, Time t)
 	clipcopy(NULL);
 }
 
+/* free a selection buffer, INCR transfers still reading it get a copy */
+void
+selfree(char *str)
+{
+	Incr *incr;
+
+	if (!str)
+		return;
+	for (incr = incrs; incr; incr = incr->next) {
+		if (incr->data != str)
+			continue;
+		incr->len -= incr->ofs;
+		incr->data = xmalloc(incr->len);
+		memcpy(incr->data, str + incr->ofs, incr->len);
+		incr->ofs = 0;
+		incr->own = 1;
+	}
+	free(str);
+}
+
+/* largest property we write or read at once */
+size_t
+selchunk(void)
+{
+	static size_t chunk;
+	long max;
+
+	if (!chunk) {
+		if (!(max = XExtendedMaxRequestSize(xw.dpy)))
+			max = XMaxRequestSize(xw.dpy);
+		/* in 4 byte units, leave room for the request header */
+		chunk = MIN((size_t)max * 4 - 1024, 1 << 20);
+	}
+	return chunk;
+}
+
+/*
+ * Select PropertyNotify on the requestor of an INCR transfer, or stop
+ * once its last transfer is done. Our own windows keep their mask.
+ */
+void
+incrselect(Incr *incr)
+{
+	long mask = PropertyChangeMask | StructureNotifyMask;
+	Incr *i;
+	Win *w;
+
+	for (i = incrs; i && i->requestor != incr->requestor; i = i->next)
+		;
+	if (!i)
+		mask = NoEventMask;
+	if ((w = wfind(incr->requestor)))
+		mask |= (w == selwin ? xw.attrs : w->xw.attrs).event_mask;
+	XSelectInput(xw.dpy, incr->requestor, mask);
+}
+
+/* PropertyNotify and DestroyNotify on requestors, 1 if handled */
+int
+incrnotify(XEvent *e)
+{
+	Incr **ip, *incr;
+	size_t n;
+
+	for (ip = &incrs; (incr = *ip); ip = &incr->next) {
+		if (e->type == DestroyNotify &&
+				e->xdestroywindow.window == incr->requestor)
+			break;
+		if (e->type == PropertyNotify &&
+				e->xproperty.window == incr->requestor &&
+				e->xproperty.atom == incr->property &&
+				e->xproperty.state == PropertyDelete)
+			break;
+	}
+	if (!incr)
+		return 0;
+
+	if (e->type == PropertyNotify) {
+		/* the requestor took the last chunk, send the next one */
+		n = MIN(selchunk(), incr->len - incr->ofs);
+		XChangeProperty(xw.dpy, incr->requestor, incr->property,
+				incr->target, 8, PropModeReplace,
+				(uchar *)incr->data + incr->ofs, n);
+		incr->ofs += n;
+		clock_gettime(CLOCK_MONOTONIC, &incr->last);
+		/* a zero-length chunk ends the transfer */
+		if (n > 0)
+			return 1;
+	} else {
+		incr->dead = 1;
+	}
+	incrdrop(ip);
+	return 1;
+}
+
+/* unlink a finished, timed out or dead transfer */
+void
+incrdrop(Incr **ip)
+{
+	Incr *incr = *ip;
+
+	*ip = incr->next;
+	if (!incr->dead)
+		incrselect(incr);
+	if (incr->own)
+		free(incr->data);
+	free(incr);
+}
+
+/*
+ * Requestors may be gone by the time our requests on their windows reach
+ * the server. Their BadWindow errors end the transfer, others are fatal.
+ */
+int
+xerror(Display *dpy, XErrorEvent *ee)
+{
+	Incr *incr;
+
+	if (ee->error_code != BadWindow || wfind(ee->resourceid) ||
+			(ee->request_code != X_ChangeProperty &&
+			 ee->request_code != X_ChangeWindowAttributes &&
+			 ee->request_code != X_SendEvent))
+		return xerrorxlib(dpy, ee);
+	for (incr = incrs; incr; incr = incr->next) {
+		if (incr->requestor == ee->resourceid)
+			incr->dead = 1;
+	}
+	return 0;
+}
+
 void
 xsetsel(char *str)
 {
@@ -1069,28 +1367,226 @@ xloadfonts(const char *fontstr, double fontsize)
 	FcPatternDestroy(pattern);
 }
 
-int
+void
 xloadsparefont(FcPattern *pattern, int flags)
+{
+	frc[frclen].font = NULL;
+	frc[frclen].pattern = FcPatternDuplicate(pattern);
+	frc[frclen].matched = 0;
+	frc[frclen].flags = flags;
+	/* Believe U+0000 glyph will present in each default font */
+	frc[frclen].unicodep = 0;
+	frclen++;
+}
+
+/*
+ * Open a spare font once it is needed for rune. Matching is put off
+ * until then too, and the charset of the match tells whether opening
+ * is worth it at all. Returns 0 if the font can't be used for rune.
+ */
+int
+xopensparefont(Fontcache *fc, Rune rune)
 {
 	FcPattern *match;
+	FcCharSet *charset;
 	FcResult result;
 
-	match = FcFontMatch(NULL, pattern, &result);
-	if (!match) {
-		return 1;
+	if (!fc->matched) {
+		if (!(match = FcFontMatch(NULL, fc->pattern, &result)))
+			goto fail;
+		FcPatternDestroy(fc->pattern);
+		fc->pattern = match;
+		fc->matched = 1;
 	}
+	if (FcPatternGetCharSet(fc->pattern, FC_CHARSET, 0, &charset)
+			== FcResultMatch && !FcCharSetHasChar(charset, rune))
+		return 0;
+	if (!(fc->font = XftFontOpenPattern(xw.dpy, fc->pattern)))
+		goto fail;
+	/* owned by the font now */
+	fc->pattern = NULL;
+	return 1;
 
-	if (!(frc[frclen].font = XftFontOpenPattern(xw.dpy, match))) {
-		FcPatternDestroy(match);
-		return 1;
+fail:
+	fprintf(stderr, "can't open spare font\n");
+	/* never ask again */
+	fc->flags = -1;
+	return 0;
+}
+
+char *
+fallbackpath(void)
+{
+	static char path[PATH_MAX];
+	char *dir, *home;
+	int n;
+
+	if ((dir = getenv("XDG_CACHE_HOME")) && dir[0])
+		n = snprintf(path, sizeof(path), "%s/st/fallback", dir);
+	else if ((home = getenv("HOME")))
+		n = snprintf(path, sizeof(path), "%s/.cache/st/fallback", home);
+	else
+		return NULL;
+
+	return (n < 0 || n >= sizeof(path)) ? NULL : path;
+}
+
+/*
+ * Hash of the names and modification times of fontconfig's configuration
+ * files and font directories: installing fonts or changing the
+ * configuration makes earlier answers worthless.
+ */
+unsigned long
+fallbackstamp(void)
+{
+	FcStrList *l[2];
+	FcChar8 *s, *c;
+	struct stat st;
+	unsigned long h = 5381;
+	int i;
+
+	l[0] = FcConfigGetConfigFiles(NULL);
+	l[1] = FcConfigGetFontDirs(NULL);
+	for (i = 0; i < 2; i++) {
+		if (!l[i])
+			continue;
+		while ((s = FcStrListNext(l[i]))) {
+			for (c = s; *c; c++)
+				h = h * 33 + *c;
+			if (!stat((char *)s, &st))
+				h = h * 33 + (unsigned long)st.st_mtime;
+		}
+		FcStrListDone(l[i]);
 	}
 
-	frc[frclen].flags = flags;
-	/* Believe U+0000 glyph will present in each default font */
-	frc[frclen].unicodep = 0;
-	frclen++;
+	return h;
+}
 
-	return 0;
+/*
+ * The on-disk cache maps codepoint ranges to the font files fontconfig
+ * picked for them, so that later runs can open those directly instead
+ * of sorting all fonts on the system. It is only valid for the primary
+ * font and the fontconfig setup it was built with, which are kept in the
+ * header line, see fallbackstamp().
+ */
+int
+fallbackfind(Font *font, int flags, Rune rune)
+{
+	char line[PATH_MAX + 64], *path;
+	uint lo, hi;
+	int i, n, fl, index;
+	FcPattern *p;
+	Fallback *fb;
+	FILE *fp;
+
+	if (fbclen < 0) {
+		fbclen = 0;
+		snprintf(fbchdr, sizeof(fbchdr), "st fallback 2 %lx %s\n",
+		         fallbackstamp(), usedfont);
+		if ((path = fallbackpath()) && (fp = fopen(path, "r"))) {
+			if (fgets(line, sizeof(line), fp) && !strcmp(line, fbchdr))
+				fbcstale = 0;
+			while (!fbcstale && fbclen < FBCMAX &&
+			       fgets(line, sizeof(line), fp)) {
+				if (sscanf(line, "%d %x %x %d %n", &fl, &lo, &hi,
+				           &index, &n) != 4 || line[n] == '\0')
+					continue;
+				line[strcspn(line, "\n")] = '\0';
+				fbc = xrealloc(fbc, (fbclen + 1) * sizeof(*fbc));
+				fbc[fbclen++] = (Fallback){ lo, hi, fl, index,
+				                            xstrdup(line + n) };
+			}
+			fclose(fp);
+			fbcfile = fbclen;
+		}
+	}
+
+	for (i = 0; i < fbclen; i++) {
+		fb = &fbc[i];
+		if (!fb->file || fb->flags != flags || rune < fb->lo || rune > fb->hi)
+			continue;
+
+		/* the query was substituted already, Xft only needs the file */
+		p = FcPatternDuplicate(font->pattern);
+		FcPatternAddString(p, FC_FILE, (FcChar8 *)fb->file);
+		FcPatternAddInteger(p, FC_INDEX, fb->index);
+
+		if (frclen >= frccap) {
+			frccap += 16;
+			frc = xrealloc(frc, frccap * sizeof(Fontcache));
+		}
+		if (!(frc[frclen].font = XftFontOpenPattern(xw.dpy, p)))
+			FcPatternDestroy(p);
+		if (!frc[frclen].font || !XftCharIndex(xw.dpy, frc[frclen].font, rune)) {
+			/* the file went away or changed, forget it */
+			if (frc[frclen].font)
+				XftFontClose(xw.dpy, frc[frclen].font);
+			free(fb->file);
+			fb->file = NULL;
+			continue;
+		}
+		frc[frclen].pattern = NULL;
+		frc[frclen].flags = flags;
+		frc[frclen].unicodep = rune;
+		return frclen++;
+	}
+
+	return -1;
+}
+
+void
+fallbackadd(FcPattern *match, int flags, Rune rune)
+{
+	FcChar8 *file;
+	FcCharSet *charset;
+	Rune lo, hi;
+	char *path, *sep;
+	int index;
+	FILE *fp;
+
+	if (FcPatternGetString(match, FC_FILE, 0, &file) != FcResultMatch ||
+	    FcPatternGetCharSet(match, FC_CHARSET, 0, &charset) != FcResultMatch)
+		return;
+	/* no font has it, the next run should ask again */
+	if (!FcCharSetHasChar(charset, rune))
+		return;
+	if (FcPatternGetInteger(match, FC_INDEX, 0, &index) != FcResultMatch)
+		index = 0;
+
+	/*
+	 * Extend to what the font covers around rune, within the same 256
+	 * codepoints: neighbours are likely to be resolved to it as well.
+	 */
+	for (lo = rune; (lo & 0xff) && FcCharSetHasChar(charset, lo - 1); lo--)
+		;
+	for (hi = rune; ((hi + 1) & 0xff) && FcCharSetHasChar(charset, hi + 1); hi++)
+		;
+
+	fbc = xrealloc(fbc, (MAX(fbclen, 0) + 1) * sizeof(*fbc));
+	fbclen = MAX(fbclen, 0);
+	fbc[fbclen++] = (Fallback){ lo, hi, flags, index, xstrdup((char *)file) };
+
+	if (!(path = fallbackpath()))
+		return;
+	for (sep = strchr(path + 1, '/'); sep; sep = strchr(sep + 1, '/')) {
+		*sep = '\0';
+		mkdir(path, 0700);
+		*sep = '/';
+	}
+
+	/* start over rather than grow without bound */
+	if (fbcfile >= FBCMAX)
+		fbcstale = 1;
+	if (!(fp = fopen(path, fbcstale ? "w" : "a")))
+		return;
+	if (fbcstale) {
+		fputs(fbchdr, fp);
+		fbcfile = 0;
+	}
+	fbcstale = 0;
+	fbcfile++;
+	fprintf(fp, "%d %x %x %d %s\n", flags, lo, hi, index, (char *)file);
+	fclose(fp);
 }
 
 void
@@ -1142,23 +1638,19 @@ xloadsparefonts(void)
 		FcConfigSubstitute(NULL, pattern, FcMatchPattern);
 		XftDefaultSubstitute(xw.dpy, xw.scr, pattern);
 
-		if (xloadsparefont(pattern, FRC_NORMAL))
-			die("can't open spare font %s\n", *fp);
+		xloadsparefont(pattern, FRC_NORMAL);
 
 		FcPatternDel(pattern, FC_SLANT);
 		FcPatternAddInteger(pattern, FC_SLANT, FC_SLANT_ITALIC);
-		if (xloadsparefont(pattern, FRC_ITALIC))
-			die("can't open spare font %s\n", *fp);
+		xloadsparefont(pattern, FRC_ITALIC);
 
 		FcPatternDel(pattern, FC_WEIGHT);
 		FcPatternAddInteger(pattern, FC_WEIGHT, FC_WEIGHT_BOLD);
-		if (xloadsparefont(pattern, FRC_ITALICBOLD))
-			die("can't open spare font %s\n", *fp);
+		xloadsparefont(pattern, FRC_ITALICBOLD);
 
 		FcPatternDel(pattern, FC_SLANT);
 		FcPatternAddInteger(pattern, FC_SLANT, FC_SLANT_ROMAN);
-		if (xloadsparefont(pattern, FRC_BOLD))
-			die("can't open spare font %s\n", *fp);
+		xloadsparefont(pattern, FRC_BOLD);
 
 		FcPatternDestroy(pattern);
 	}
@@ -1177,8 +1669,12 @@ void
 xunloadfonts(void)
 {
 	/* Free the loaded fonts in the font cache.  */
-	while (frclen > 0)
-		XftFontClose(xw.dpy, frc[--frclen].font);
+	while (frclen > 0) {
+		if (frc[--frclen].font)
+			XftFontClose(xw.dpy, frc[frclen].font);
+		else
+			FcPatternDestroy(frc[frclen].pattern);
+	}
 
 	xunloadfont(&dc.font);
 	xunloadfont(&dc.bfont);
@@ -1189,8 +1685,8 @@ xunloadfonts(void)
 int
 ximopen(Display *dpy)
 {
-	XIMCallback imdestroy = { .client_data = NULL, .callback = ximdestroy };
-	XICCallback icdestroy = { .client_data = NULL, .callback = xicdestroy };
+	XIMCallback imdestroy = { .client_data = (XPointer)selwin, .callback = ximdestroy };
+	XICCallback icdestroy = { .client_data = (XPointer)selwin, .callback = xicdestroy };
 
 	xw.ime.xim = XOpenIM(xw.dpy, NULL, NULL, NULL);
 	if (xw.ime.xim == NULL)
@@ -1219,41 +1715,56 @@ ximopen(Display *dpy)
 void
 ximinstantiate(Display *dpy, XPointer client, XPointer call)
 {
+	wswitch((Win *)client);
 	if (ximopen(dpy))
 		XUnregisterIMInstantiateCallback(xw.dpy, NULL, NULL, NULL,
-		                                 ximinstantiate, NULL);
+		                                 ximinstantiate, client);
 }
 
 void
 ximdestroy(XIM xim, XPointer client, XPointer call)
 {
+	Win *w;
+
+	/* the window may be gone already */
+	for (w = wins; w && w != (Win *)client; w = w->next)
+		;
+	if (!w)
+		return;
+	wswitch(w);
 	xw.ime.xim = NULL;
 	XRegisterIMInstantiateCallback(xw.dpy, NULL, NULL, NULL,
-	                               ximinstantiate, NULL);
+	                               ximinstantiate, client);
 	XFree(xw.ime.spotlist);
 }
 
 int
 xicdestroy(XIC xim, XPointer client, XPointer call)
 {
-	xw.ime.xic = NULL;
+	Win *w;
+
+	for (w = wins; w && w != (Win *)client; w = w->next)
+		;
+	if (w) {
+		wswitch(w);
+		xw.ime.xic = NULL;
+	}
 	return 1;
 }
 
 void
-xinit(int cols, int rows)
+xinit(void)
 {
-	XGCValues gcvalues;
-	Cursor cursor;
 	Window parent, root;
-	pid_t thispid = getpid();
-	XColor xmousefg, xmousebg;
 	XWindowAttributes attr;
 	XVisualInfo vis;
 
 	if (!(xw.dpy = XOpenDisplay(NULL)))
 		die("can't open display\n");
+	xerrorxlib = XSetErrorHandler(xerror);
 	xw.scr = XDefaultScreen(xw.dpy);
+	/* shells must not inherit the connection */
+	fcntl(XConnectionNumber(xw.dpy), F_SETFD, FD_CLOEXEC);
 
 	root = XRootWindow(xw.dpy, xw.scr);
 	if (!(opt_embed && (parent = strtol(opt_embed, NULL, 0))))
@@ -1282,6 +1793,30 @@ xinit(int cols, int rows)
 	xw.cmap = XCreateColormap(xw.dpy, parent, xw.vis, None);
 	xloadcols();
 
+	xw.xembed = XInternAtom(xw.dpy, "_XEMBED", False);
+	xw.wmdeletewin = XInternAtom(xw.dpy, "WM_DELETE_WINDOW", False);
+	xw.netwmname = XInternAtom(xw.dpy, "_NET_WM_NAME", False);
+	xw.netwmiconname = XInternAtom(xw.dpy, "_NET_WM_ICON_NAME", False);
+	xw.netwmpid = XInternAtom(xw.dpy, "_NET_WM_PID", False);
+
+	xsel.xtarget = XInternAtom(xw.dpy, "UTF8_STRING", 0);
+	if (xsel.xtarget == None)
+		xsel.xtarget = XA_STRING;
+}
+
+void
+xcreate(int cols, int rows)
+{
+	XGCValues gcvalues;
+	Cursor cursor;
+	Window parent, root;
+	pid_t thispid = getpid();
+	XColor xmousefg, xmousebg;
+
+	root = XRootWindow(xw.dpy, xw.scr);
+	if (!(opt_embed && (parent = strtol(opt_embed, NULL, 0))))
+		parent = root;
+
 	/* adjust fixed window geometry */
 	win.w = 2 * win.hborderpx + 2 * borderpx + cols * win.cw;
 	win.h = 2 * win.vborderpx + 2 * borderpx + rows * win.ch;
@@ -1306,10 +1841,13 @@ xinit(int cols, int rows)
 	if (parent != root)
 		XReparentWindow(xw.dpy, xw.win, parent, xw.l, xw.t);
 
-	memset(&gcvalues, 0, sizeof(gcvalues));
-	gcvalues.graphics_exposures = False;
-	dc.gc = XCreateGC(xw.dpy, xw.win, GCGraphicsExposures,
-			&gcvalues);
+	/* one GC serves every window, they share depth and screen */
+	if (!dc.gc) {
+		memset(&gcvalues, 0, sizeof(gcvalues));
+		gcvalues.graphics_exposures = False;
+		dc.gc = XCreateGC(xw.dpy, xw.win, GCGraphicsExposures,
+				&gcvalues);
+	}
 	xw.buf = XCreatePixmap(xw.dpy, xw.win, win.w, win.h,
 			xw.depth);
 	XSetForeground(xw.dpy, dc.gc, dc.col[defaultbg].pixel);
@@ -1324,7 +1862,7 @@ xinit(int cols, int rows)
 	/* input methods */
 	if (!ximopen(xw.dpy)) {
 		XRegisterIMInstantiateCallback(xw.dpy, NULL, NULL, NULL,
-	                                       ximinstantiate, NULL);
+	                                       ximinstantiate, (XPointer)selwin);
 	}
 
 	/* white cursor, black outline */
@@ -1344,14 +1882,10 @@ xinit(int cols, int rows)
 	}
 
 	XRecolorCursor(xw.dpy, cursor, &xmousefg, &xmousebg);
+	/* the window holds on to it */
+	XFreeCursor(xw.dpy, cursor);
 
-	xw.xembed = XInternAtom(xw.dpy, "_XEMBED", False);
-	xw.wmdeletewin = XInternAtom(xw.dpy, "WM_DELETE_WINDOW", False);
-	xw.netwmname = XInternAtom(xw.dpy, "_NET_WM_NAME", False);
-	xw.netwmiconname = XInternAtom(xw.dpy, "_NET_WM_ICON_NAME", False);
 	XSetWMProtocols(xw.dpy, xw.win, &xw.wmdeletewin, 1);
-
-	xw.netwmpid = XInternAtom(xw.dpy, "_NET_WM_PID", False);
 	XChangeProperty(xw.dpy, xw.win, xw.netwmpid, XA_CARDINAL, 32,
 			PropModeReplace, (uchar *)&thispid, 1);
 
@@ -1365,9 +1899,6 @@ xinit(int cols, int rows)
 	clock_gettime(CLOCK_MONOTONIC, &xsel.tclick2);
 	xsel.primary = NULL;
 	xsel.clipboard = NULL;
-	xsel.xtarget = XInternAtom(xw.dpy, "UTF8_STRING", 0);
-	if (xsel.xtarget == None)
-		xsel.xtarget = XA_STRING;
 }
 
 int
@@ -1385,6 +1916,10 @@ xmakeglyphfontspecs(XftGlyphFontSpec *specs, const Glyph *glyphs, int len, int x
 	FcFontSet *fcsets[] = { NULL };
 	FcCharSet *fccharset;
 	int i, f, numspecs = 0;
+#ifdef FBTIME
+	struct timespec fbt0, fbt1;
+	int fbsearch, fbhit = 0;
+#endif
 
 	for (i = 0, xp = winx, yp = winy + font->ascent; i < len; ++i) {
 		/* Fetch rune and mode for current glyph. */
@@ -1428,6 +1963,10 @@ xmakeglyphfontspecs(XftGlyphFontSpec *specs, const Glyph *glyphs, int len, int x
 
 		/* Fallback on font cache, search the font cache for match. */
 		for (f = 0; f < frclen; f++) {
+			if (frc[f].flags != frcflags)
+				continue;
+			if (!frc[f].font && !xopensparefont(&frc[f], rune))
+				continue;
 			glyphidx = XftCharIndex(xw.dpy, frc[f].font, rune);
 			/* Everything correct. */
 			if (glyphidx && frc[f].flags == frcflags)
@@ -1439,8 +1978,19 @@ xmakeglyphfontspecs(XftGlyphFontSpec *specs, const Glyph *glyphs, int len, int x
 			}
 		}
 
+#ifdef FBTIME
+		if ((fbsearch = f >= frclen))
+			clock_gettime(CLOCK_MONOTONIC, &fbt0);
+#endif
+		/* Try the fonts earlier runs resolved for this rune. */
+		if (f >= frclen && (f = fallbackfind(font, frcflags, rune)) >= 0)
+			glyphidx = XftCharIndex(xw.dpy, frc[f].font, rune);
+#ifdef FBTIME
+		fbhit = f >= 0;
+#endif
+
 		/* Nothing was found. Use fontconfig to find matching font. */
-		if (f >= frclen) {
+		if (f < 0) {
 			if (!font->set)
 				font->set = FcFontSort(0, font->pattern,
 				                       1, 0, &fcres);
@@ -1467,6 +2017,8 @@ xmakeglyphfontspecs(XftGlyphFontSpec *specs, const Glyph *glyphs, int len, int x
 
 			fontpattern = FcFontSetMatch(0, fcsets, 1,
 					fcpattern, &fcres);
+			if (fontpattern)
+				fallbackadd(fontpattern, frcflags, rune);
 
 			/* Allocate memory for the new cache entry. */
 			if (frclen >= frccap) {
@@ -1479,6 +2031,7 @@ xmakeglyphfontspecs(XftGlyphFontSpec *specs, const Glyph *glyphs, int len, int x
 			if (!frc[frclen].font)
 				die("XftFontOpenPattern failed seeking fallback font: %s\n",
 					strerror(errno));
+			frc[frclen].pattern = NULL;
 			frc[frclen].flags = frcflags;
 			frc[frclen].unicodep = rune;
 
@@ -1490,6 +2043,15 @@ xmakeglyphfontspecs(XftGlyphFontSpec *specs, const Glyph *glyphs, int len, int x
 			FcPatternDestroy(fcpattern);
 			FcCharSetDestroy(fccharset);
 		}
+#ifdef FBTIME
+		if (fbsearch) {
+			clock_gettime(CLOCK_MONOTONIC, &fbt1);
+			fprintf(stderr, "st: U+%04X in %.3f ms from %s\n", rune,
+			        (fbt1.tv_sec - fbt0.tv_sec) * 1E3 +
+			        (fbt1.tv_nsec - fbt0.tv_nsec) / 1E6,
+			        fbhit ? "the fallback cache" : "fontconfig");
+		}
+#endif
 
 		specs[numspecs].font = frc[f].font;
 		specs[numspecs].glyph = glyphidx;
@@ -2031,7 +2593,7 @@ cmessage(XEvent *e)
 		}
 	} else if (e->xclient.data.l[0] == xw.wmdeletewin) {
 		ttyhangup();
-		exit(0);
+		xclose();
 	}
 }
 
@@ -2045,38 +2607,364 @@ resize(XEvent *e)
 }
 
 void
-run(void)
+xclose(void)
 {
-	XEvent ev;
-	int w = win.w, h = win.h;
-	fd_set rfd;
-	int xfd = XConnectionNumber(xw.dpy), ttyfd, xev, drawing;
-	struct timespec seltv, *tv, now, lastblink, trigger;
-	double timeout;
+	if (!servermode)
+		exit(0);
+	/* run() disposes of it, we may be deep inside a handler here */
+	selwin->closed = 1;
+}
 
-	/* Waiting for window mapping */
-	do {
-		XNextEvent(xw.dpy, &ev);
-		/*
-		 * This XFilterEvent call is required because of XOpenIM. It
-		 * does filter out the key event and some client message for
-		 * the input method too.
-		 */
-		if (XFilterEvent(&ev, None))
-			continue;
-		if (ev.type == ConfigureNotify) {
-			w = ev.xconfigure.width;
-			h = ev.xconfigure.height;
+Win *
+wnew(void)
+{
+	Win *w = xmalloc(sizeof(*w));
+
+	*w = (Win){ .ttyfd = -1, .timeout = -1 };
+	w->next = wins;
+	wins = selwin = w;
+
+	cols = MAX(cols, 1);
+	rows = MAX(rows, 1);
+	tnew(cols, rows);
+	xcreate(cols, rows);
+	selinit();
+	w->xw.win = xw.win;
+
+	return w;
+}
+
+void
+wfree(Win *w)
+{
+	Win **tw;
+
+	wswitch(w);
+	tfree();
+
+	/* unlink first, closing the IM may call back into ximdestroy() */
+	for (tw = &wins; *tw != w; tw = &(*tw)->next)
+		;
+	*tw = w->next;
+
+	if (xw.ime.xic)
+		XDestroyIC(xw.ime.xic);
+	if (xw.ime.xim) {
+		XCloseIM(xw.ime.xim);
+		XFree(xw.ime.spotlist);
+	}
+	XUnregisterIMInstantiateCallback(xw.dpy, NULL, NULL, NULL,
+	                                 ximinstantiate, (XPointer)w);
+	XftDrawDestroy(xw.draw);
+	XFreePixmap(xw.dpy, xw.buf);
+	XDestroyWindow(xw.dpy, xw.win);
+	free(xw.specbuf);
+	selfree(xsel.primary);
+	selfree(xsel.clipboard);
+
+	free(w->term);
+	free(w->req);
+	free(w->reqv);
+	free(w);
+	selwin = NULL;
+}
+
+Win *
+wfind(Window id)
+{
+	Win *w;
+
+	for (w = wins; w && w->xw.win != id; w = w->next)
+		;
+	return w;
+}
+
+void
+wsave(Win *w)
+{
+	w->xw = xw;
+	w->win = win;
+	w->xsel = xsel;
+	w->buttons = buttons;
+	w->opt_class = opt_class;
+	w->opt_cmd = opt_cmd;
+	w->opt_embed = opt_embed;
+	w->opt_io = opt_io;
+	w->opt_line = opt_line;
+	w->opt_name = opt_name;
+	w->opt_title = opt_title;
+	w->term = tsave(w->term);
+}
+
+void
+wload(Win *w)
+{
+	xw = w->xw;
+	win = w->win;
+	xsel = w->xsel;
+	buttons = w->buttons;
+	opt_class = w->opt_class;
+	opt_cmd = w->opt_cmd;
+	opt_embed = w->opt_embed;
+	opt_io = w->opt_io;
+	opt_line = w->opt_line;
+	opt_name = w->opt_name;
+	opt_title = w->opt_title;
+	tload(w->term);
+}
+
+void
+wswitch(Win *w)
+{
+	if (w == selwin)
+		return;
+	if (selwin)
+		wsave(selwin);
+	wload(w);
+	selwin = w;
+}
+
+/* defaults for the per-window globals, before parsing a request */
+void
+wreset(void)
+{
+	opt_class = opt_embed = opt_io = opt_line = opt_name = NULL;
+	opt_title = NULL;
+	opt_cmd = NULL;
+	cols = defcols;
+	rows = defrows;
+	xw.l = xw.t = xw.gm = 0;
+	xw.isfixed = False;
+	memset(&xw.ime, 0, sizeof(xw.ime));
+	win.hborderpx = win.vborderpx = 0;
+	xsetcursor(cursorshape);
+	buttons = 0;
+}
+
+void
+wdraw(Win *w, struct timespec now)
+{
+	/*
+	 * To reduce flicker and tearing, when new content or event
+	 * triggers drawing, we first wait a bit to ensure we got
+	 * everything, and if nothing new arrives - we draw.
+	 * We start with trying to wait minlatency ms. If more content
+	 * arrives sooner, we retry with shorter and shorter periods,
+	 * and eventually draw even without idle after maxlatency ms.
+	 * Typically this results in low latency while interacting,
+	 * maximum latency intervals during `cat huge.txt`, and perfect
+	 * sync with periodic updates from animations/key-repeats/etc.
+	 */
+	w->tv = now;
+	if (w->ev) {
+		w->ev = 0;
+		if (!w->drawing) {
+			w->trigger = now;
+			w->drawing = 1;
+		}
+		w->timeout = (maxlatency - TIMEDIFF(now, w->trigger)) \
+		             / maxlatency * minlatency;
+		/* a closed synchronized update is a complete frame */
+		if (w->timeout > 0 && !(w->syncing && !tinsync(synctimeout)))
+			return;  /* we have time, try to find idle */
+	}
+
+	/*
+	 * While the application keeps a synchronized update open the
+	 * screen is only half-updated, so hold the frame back. drawing
+	 * stays set: we draw as soon as the update is closed or it
+	 * times out.
+	 */
+	if (tinsync(synctimeout)) {
+		w->timeout = synctimeout;
+		return;
+	}
+
+	/* idle detected or maxlatency exhausted -> draw */
+	w->timeout = -1;
+	if (blinktimeout && tattrset(ATTR_BLINK)) {
+		w->timeout = blinktimeout - TIMEDIFF(now, w->lastblink);
+		if (w->timeout <= 0) {
+			if (-w->timeout > blinktimeout) /* start visible */
+				win.mode |= MODE_BLINK;
+			win.mode ^= MODE_BLINK;
+			tsetdirtattr(ATTR_BLINK);
+			w->lastblink = now;
+			w->timeout = blinktimeout;
+		}
+	}
+
+	draw();
+	w->drawing = 0;
+}
+
+void
+srvinit(void)
+{
+	char *dir, *disp;
+	mode_t mask;
+	int fd;
+
+	if (!(dir = getenv("XDG_RUNTIME_DIR")))
+		dir = "/tmp";
+	if (!(disp = getenv("DISPLAY")))
+		disp = "";
+	snprintf(srvaddr.sun_path, sizeof(srvaddr.sun_path), SOCKFMT,
+	         dir, (int)getuid(), disp);
+
+	if ((srvfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		die("socket: %s\n", strerror(errno));
+	fcntl(srvfd, F_SETFD, FD_CLOEXEC);
+
+	/* only a stale socket may be replaced */
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) >= 0) {
+		if (!connect(fd, (struct sockaddr *)&srvaddr, sizeof(srvaddr)))
+			die("%s: already serving on %s\n", argv0, srvaddr.sun_path);
+		close(fd);
+	}
+	unlink(srvaddr.sun_path);
+
+	mask = umask(077);
+	if (bind(srvfd, (struct sockaddr *)&srvaddr, sizeof(srvaddr)) < 0)
+		die("bind %s: %s\n", srvaddr.sun_path, strerror(errno));
+	umask(mask);
+	if (listen(srvfd, 16) < 0)
+		die("listen: %s\n", strerror(errno));
+
+	defcols = cols;
+	defrows = rows;
+}
+
+void
+srvaccept(void)
+{
+	Req *r;
+	int fd;
+
+	if ((fd = accept(srvfd, NULL, NULL)) < 0)
+		return;
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	r = xmalloc(sizeof(*r));
+	*r = (Req){ fd, NULL, 0, 0, { 0 }, reqs };
+	clock_gettime(CLOCK_MONOTONIC, &r->start);
+	reqs = r;
+}
+
+/*
+ * Read what r's stc has sent so far. The request is cwd '\0' { arg '\0' }
+ * and ends when stc shuts down its end. 1 when r is done with.
+ */
+int
+srvread(Req *r)
+{
+	ssize_t n;
+
+	for (;;) {
+		if (r->len + 1 >= r->siz)
+			r->buf = xrealloc(r->buf, r->siz += BUFSIZ);
+		if ((n = read(r->fd, r->buf + r->len, r->siz - r->len - 1)) < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			srvdrop(r, NULL);
+			return 1;
+		}
+		if (n == 0)
+			break;
+		if ((r->len += n) > REQMAX) {
+			srvdrop(r, "st: request too long\n");
+			return 1;
 		}
-	} while (ev.type != MapNotify);
+	}
+	r->buf[r->len] = '\0';
+	srvrequest(r);
+	return 1;
+}
+
+void
+srvrequest(Req *r)
+{
+	static const char badopts[] = "st: invalid options, see st(1)\n";
+	char *req = r->buf, *p, **argv;
+	size_t len = r->len;
+	int argc;
+	Win *w;
+
+	for (argc = 1, p = req + strlen(req) + 1; p < req + len; p += strlen(p) + 1)
+		argc++;
+	argv = xmalloc((argc + 1) * sizeof(*argv));
+	argv[0] = argv0;
+	for (argc = 1, p = req + strlen(req) + 1; p < req + len; p += strlen(p) + 1)
+		argv[argc++] = p;
+	argv[argc] = NULL;
+
+	if (selwin)
+		wsave(selwin);
+	selwin = NULL;
+	wreset();
+	if (parseargs(argc, argv, 1) < 0) {
+		free(argv);
+		srvdrop(r, badopts);
+		return;
+	}
 
-	ttyfd = ttynew(opt_line, shell, opt_io, opt_cmd);
-	cresize(w, h);
+	w = wnew();
+	w->cwd = req[0] ? req : NULL;
+	w->req = req;
+	w->reqv = argv;
+	r->buf = NULL;
+	srvdrop(r, NULL);
+}
+
+/* close r, telling its stc msg first if there is one */
+void
+srvdrop(Req *r, const char *msg)
+{
+	Req **rp;
 
-	for (timeout = -1, drawing = 0, lastblink = (struct timespec){0};;) {
+	for (rp = &reqs; *rp != r; rp = &(*rp)->next)
+		;
+	*rp = r->next;
+	if (msg)
+		send(r->fd, msg, strlen(msg), MSG_NOSIGNAL);
+	close(r->fd);
+	free(r->buf);
+	free(r);
+}
+
+void
+run(void)
+{
+	XEvent ev;
+	fd_set rfd;
+	int xfd = XConnectionNumber(xw.dpy), maxfd;
+	struct timespec seltv, *tv, now;
+	double timeout, left;
+	Win *w, *next;
+	Req *r, *rnext;
+	Incr **ip, *incr;
+
+	for (timeout = -1;;) {
 		FD_ZERO(&rfd);
-		FD_SET(ttyfd, &rfd);
 		FD_SET(xfd, &rfd);
+		maxfd = xfd;
+		if (srvfd >= 0) {
+			FD_SET(srvfd, &rfd);
+			maxfd = MAX(maxfd, srvfd);
+		}
+		for (r = reqs; r; r = r->next) {
+			FD_SET(r->fd, &rfd);
+			maxfd = MAX(maxfd, r->fd);
+		}
+		for (w = wins; w; w = w->next) {
+			if (w->ttyfd < 0 || w->closed)
+				continue;
+			FD_SET(w->ttyfd, &rfd);
+			maxfd = MAX(maxfd, w->ttyfd);
+		}
 
 		if (XPending(xw.dpy))
 			timeout = 0;  /* existing events might not set xfd */
@@ -2085,134 +2973,188 @@ run(void)
 		seltv.tv_nsec = 1E6 * (timeout - 1E3 * seltv.tv_sec);
 		tv = timeout >= 0 ? &seltv : NULL;
 
-		if (pselect(MAX(xfd, ttyfd)+1, &rfd, NULL, NULL, tv, NULL) < 0) {
+		if (pselect(maxfd+1, &rfd, NULL, NULL, tv, NULL) < 0) {
 			if (errno == EINTR)
 				continue;
 			die("select failed: %s\n", strerror(errno));
 		}
 		clock_gettime(CLOCK_MONOTONIC, &now);
 
-		if (FD_ISSET(ttyfd, &rfd))
+		for (w = wins; w; w = w->next) {
+			if (w->ttyfd < 0 || w->closed || !FD_ISSET(w->ttyfd, &rfd))
+				continue;
+			wswitch(w);
+			w->syncing = tinsync(synctimeout);
 			ttyread();
+			w->ev = 1;
+		}
 
-		xev = 0;
 		while (XPending(xw.dpy)) {
-			xev = 1;
 			XNextEvent(xw.dpy, &ev);
+			/*
+			 * This XFilterEvent call is required because of XOpenIM. It
+			 * does filter out the key event and some client message for
+			 * the input method too.
+			 */
 			if (XFilterEvent(&ev, None))
 				continue;
-			if (handler[ev.type])
-				(handler[ev.type])(&ev);
-		}
+			if (!(w = wfind(ev.xany.window)) || w->closed) {
+				/* requestors of our INCR transfers */
+				incrnotify(&ev);
+				continue;
+			}
+			wswitch(w);
+			w->ev = 1;
+			if (w->ttyfd >= 0) {
+				if (handler[ev.type])
+					(handler[ev.type])(&ev);
+				continue;
+			}
 
-		/*
-		 * To reduce flicker and tearing, when new content or event
-		 * triggers drawing, we first wait a bit to ensure we got
-		 * everything, and if nothing new arrives - we draw.
-		 * We start with trying to wait minlatency ms. If more content
-		 * arrives sooner, we retry with shorter and shorter periods,
-		 * and eventually draw even without idle after maxlatency ms.
-		 * Typically this results in low latency while interacting,
-		 * maximum latency intervals during `cat huge.txt`, and perfect
-		 * sync with periodic updates from animations/key-repeats/etc.
-		 */
-		if (FD_ISSET(ttyfd, &rfd) || xev) {
-			if (!drawing) {
-				trigger = now;
-				drawing = 1;
+			/* Waiting for window mapping */
+			if (ev.type == ConfigureNotify) {
+				win.w = ev.xconfigure.width;
+				win.h = ev.xconfigure.height;
+			} else if (ev.type == MapNotify) {
+				xsetenv();
+				w->ttyfd = ttynew(opt_line, shell, opt_io, opt_cmd,
+				                  w->cwd);
+				cresize(0, 0);
 			}
-			timeout = (maxlatency - TIMEDIFF(now, trigger)) \
-			          / maxlatency * minlatency;
-			if (timeout > 0)
-				continue;  /* we have time, try to find idle */
 		}
 
-		/* idle detected or maxlatency exhausted -> draw */
-		timeout = -1;
-		if (blinktimeout && tattrset(ATTR_BLINK)) {
-			timeout = blinktimeout - TIMEDIFF(now, lastblink);
-			if (timeout <= 0) {
-				if (-timeout > blinktimeout) /* start visible */
-					win.mode |= MODE_BLINK;
-				win.mode ^= MODE_BLINK;
-				tsetdirtattr(ATTR_BLINK);
-				lastblink = now;
-				timeout = blinktimeout;
-			}
+		/* a stalled stc must not hold up the windows */
+		for (r = reqs; r; r = rnext) {
+			rnext = r->next;
+			if (FD_ISSET(r->fd, &rfd) && srvread(r))
+				continue;
+			if (TIMEDIFF(now, r->start) >= REQTIMEOUT)
+				srvdrop(r, "st: request timed out\n");
+		}
+		if (srvfd >= 0 && FD_ISSET(srvfd, &rfd))
+			srvaccept();
+		for (ip = &incrs; (incr = *ip);) {
+			if (incr->dead || TIMEDIFF(now, incr->last) >= INCRTIMEOUT)
+				incrdrop(ip);
+			else
+				ip = &incr->next;
 		}
 
-		draw();
+		for (timeout = -1, w = wins; w; w = next) {
+			next = w->next;
+			if (w->closed) {
+				wfree(w);
+				continue;
+			}
+			if (w->ttyfd < 0)
+				continue;
+			left = w->timeout - TIMEDIFF(now, w->tv);
+			if (w->ev || (w->timeout >= 0 && left <= 0)) {
+				wswitch(w);
+				wdraw(w, now);
+				w->syncing = 0;
+				left = w->timeout;
+			}
+			if (w->timeout >= 0 && (timeout < 0 || left < timeout))
+				timeout = MAX(left, 0);
+		}
+		for (r = reqs; r; r = r->next) {
+			left = REQTIMEOUT - TIMEDIFF(now, r->start);
+			if (timeout < 0 || left < timeout)
+				timeout = MAX(left, 0);
+		}
+		for (incr = incrs; incr; incr = incr->next) {
+			left = INCRTIMEOUT - TIMEDIFF(now, incr->last);
+			if (timeout < 0 || left < timeout)
+				timeout = MAX(left, 0);
+		}
 		XFlush(xw.dpy);
-		drawing = 0;
 	}
 }
 
 void
 usage(void)
 {
-	die("usage: %s [-aiv] [-c class] [-f font] [-g geometry]"
+	die("usage: %s [-adiv] [-c class] [-f font] [-g geometry]"
 	    " [-n name] [-o file]\n"
 	    "          [-T title] [-t title] [-w windowid]"
 	    " [[-e] command [args ...]]\n"
-	    "       %s [-aiv] [-c class] [-f font] [-g geometry]"
+	    "       %s [-adiv] [-c class] [-f font] [-g geometry]"
 	    " [-n name] [-o file]\n"
 	    "          [-T title] [-t title] [-w windowid] -l line"
 	    " [stty_args ...]\n", argv0, argv0);
 }
 
+/*
+ * Options of the current window; req is set for stc requests, which
+ * cannot change what all windows of a server share. -1 on bad usage.
+ */
 int
-main(int argc, char *argv[])
+parseargs(int argc, char *argv[], int req)
 {
-	xw.l = xw.t = 0;
-	xw.isfixed = False;
-	xsetcursor(cursorshape);
+	char *p;
 
 	ARGBEGIN {
-	case 'a':
-		allowaltscreen = 0;
-		break;
-	case 'A':
-		alpha = strtof(EARGF(usage()), NULL);
-		LIMIT(alpha, 0.0, 1.0);
-		break;
 	case 'c':
-		opt_class = EARGF(usage());
+		if (!(opt_class = ARGF()))
+			return -1;
 		break;
 	case 'e':
 		if (argc > 0)
 			--argc, ++argv;
 		goto run;
-	case 'f':
-		opt_font = EARGF(usage());
-		break;
 	case 'g':
-		xw.gm = XParseGeometry(EARGF(usage()),
-				&xw.l, &xw.t, &cols, &rows);
+		if (!(p = ARGF()))
+			return -1;
+		xw.gm = XParseGeometry(p, &xw.l, &xw.t, &cols, &rows);
 		break;
 	case 'i':
 		xw.isfixed = 1;
 		break;
 	case 'o':
-		opt_io = EARGF(usage());
+		if (!(opt_io = ARGF()))
+			return -1;
 		break;
 	case 'l':
-		opt_line = EARGF(usage());
+		if (!(opt_line = ARGF()))
+			return -1;
 		break;
 	case 'n':
-		opt_name = EARGF(usage());
+		if (!(opt_name = ARGF()))
+			return -1;
 		break;
 	case 't':
 	case 'T':
-		opt_title = EARGF(usage());
+		if (!(opt_title = ARGF()))
+			return -1;
 		break;
 	case 'w':
-		opt_embed = EARGF(usage());
-		break;
-	case 'v':
-		die("%s " VERSION "\n", argv0);
+		if (!(opt_embed = ARGF()))
+			return -1;
 		break;
 	default:
-		usage();
+		if (req)
+			return -1;
+		switch (ARGC()) {
+		case 'a':
+			allowaltscreen = 0;
+			break;
+		case 'A':
+			alpha = strtof(EARGF(usage()), NULL);
+			LIMIT(alpha, 0.0, 1.0);
+			break;
+		case 'd':
+			servermode = 1;
+			break;
+		case 'f':
+			opt_font = EARGF(usage());
+			break;
+		case 'v':
+			die("%s " VERSION "\n", argv0);
+			break;
+		default:
+			return -1;
+		}
 	} ARGEND;
 
 run:
@@ -2222,14 +3164,26 @@ run:
 	if (!opt_title)
 		opt_title = (opt_line || !opt_cmd) ? "st" : opt_cmd[0];
 
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	xw.l = xw.t = 0;
+	xw.isfixed = False;
+	xsetcursor(cursorshape);
+
+	if (parseargs(argc, argv, 0) < 0)
+		usage();
+
 	setlocale(LC_CTYPE, "");
 	XSetLocaleModifiers("");
-	cols = MAX(cols, 1);
-	rows = MAX(rows, 1);
-	tnew(cols, rows);
-	xinit(cols, rows);
-	xsetenv();
-	selinit();
+	xinit();
+	if (servermode)
+		srvinit();
+	else
+		wnew();
 	run();
 
 	return 0;